@@ -0,0 +1,37 @@
+#include "bench_util.h"
+
+#include <cstdlib>
+#include <malloc.h>
+#include <new>
+
+namespace bench
+{
+
+    std::atomic<size_t> allocations = 0;
+    std::atomic<size_t> allocated_bytes = 0;
+    std::atomic<size_t> live_bytes = 0;
+
+} // namespace bench
+
+void *operator new(size_t size)
+{
+    ++bench::allocations;
+    bench::allocated_bytes += size;
+    if (void *p = std::malloc(size))
+    {
+        bench::live_bytes += malloc_usable_size(p);
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    bench::live_bytes -= malloc_usable_size(p);
+    std::free(p);
+}
+
+void operator delete(void *p, size_t /*size*/) noexcept
+{
+    operator delete(p);
+}
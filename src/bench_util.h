@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+
+namespace bench
+{
+
+    // Счётчики выделений памяти. bench_util.cpp подменяет глобальные operator new/delete,
+    // поэтому он линкуется только в бенчмарки. Атомарные, так как параллельный разбор
+    // выделяет память из нескольких потоков
+    extern std::atomic<size_t> allocations;
+    extern std::atomic<size_t> allocated_bytes;
+    // Объём живых блоков с учётом округления в malloc
+    extern std::atomic<size_t> live_bytes;
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Measure
+    {
+        double seconds = 0;
+        size_t allocations = 0;
+        size_t bytes = 0;
+    };
+
+    // Время работы fn и выделения памяти за это время
+    template <typename Fn>
+    Measure Run(Fn fn)
+    {
+        const size_t allocs_before = allocations;
+        const size_t bytes_before = allocated_bytes;
+        const auto start = Clock::now();
+        fn();
+        const auto finish = Clock::now();
+        return {std::chrono::duration<double>(finish - start).count(),
+                allocations - allocs_before,
+                allocated_bytes - bytes_before};
+    }
+
+} // namespace bench
@@ -0,0 +1,558 @@
+#include "char_scan.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define MYTHON_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+namespace parse::scan
+{
+
+    namespace
+    {
+        // Класс символов задаётся функтором: побайтовая проверка и, на x86-64,
+        // проверка блока, возвращающая 0xFF в байтах, принадлежащих классу
+        struct IdentifierClass
+        {
+            bool operator()(char c) const
+            {
+                return IsIdentifierChar(c);
+            }
+
+#ifdef MYTHON_SCAN_X86
+            __m128i Sse2(__m128i v) const
+            {
+                // Байты >= 0x80 отрицательны и не попадают ни в один диапазон
+                __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+                __m128i letter = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                                               _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+                __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+                                              _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+                __m128i underscore = _mm_cmpeq_epi8(v, _mm_set1_epi8('_'));
+                return _mm_or_si128(_mm_or_si128(letter, digit), underscore);
+            }
+
+            __attribute__((target("avx2"))) __m256i Avx2(__m256i v) const
+            {
+                __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+                __m256i letter = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+                                                  _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lower));
+                __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('0' - 1)),
+                                                 _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), v));
+                __m256i underscore = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_'));
+                return _mm256_or_si256(_mm256_or_si256(letter, digit), underscore);
+            }
+#endif
+        };
+
+        struct DigitClass
+        {
+            bool operator()(char c) const
+            {
+                return IsDigit(c);
+            }
+
+#ifdef MYTHON_SCAN_X86
+            __m128i Sse2(__m128i v) const
+            {
+                return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+                                     _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+            }
+
+            __attribute__((target("avx2"))) __m256i Avx2(__m256i v) const
+            {
+                return _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('0' - 1)),
+                                        _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), v));
+            }
+#endif
+        };
+
+        struct SpaceClass
+        {
+            bool operator()(char c) const
+            {
+                return IsSpace(c);
+            }
+
+#ifdef MYTHON_SCAN_X86
+            __m128i Sse2(__m128i v) const
+            {
+                __m128i control = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('\t' - 1)),
+                                                _mm_cmplt_epi8(v, _mm_set1_epi8('\r' + 1)));
+                return _mm_or_si128(control, _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+            }
+
+            __attribute__((target("avx2"))) __m256i Avx2(__m256i v) const
+            {
+                __m256i control = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('\t' - 1)),
+                                                   _mm256_cmpgt_epi8(_mm256_set1_epi8('\r' + 1), v));
+                return _mm256_or_si256(control, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+            }
+#endif
+        };
+
+        struct IndentClass
+        {
+            bool operator()(char c) const
+            {
+                return c == ' ' || c == '\t' || c == '\n';
+            }
+
+#ifdef MYTHON_SCAN_X86
+            __m128i Sse2(__m128i v) const
+            {
+                return _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                                                 _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+                                    _mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+            }
+
+            __attribute__((target("avx2"))) __m256i Avx2(__m256i v) const
+            {
+                return _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                                                       _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+                                       _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+            }
+#endif
+        };
+
+        // Всё, кроме закрывающей кавычки и обратной косой черты
+        struct StringBodyClass
+        {
+            char quote;
+
+            bool operator()(char c) const
+            {
+                return c != quote && c != '\\';
+            }
+
+#ifdef MYTHON_SCAN_X86
+            __m128i Sse2(__m128i v) const
+            {
+                __m128i stop = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(quote)),
+                                            _mm_cmpeq_epi8(v, _mm_set1_epi8('\\')));
+                return _mm_andnot_si128(stop, _mm_set1_epi8(-1));
+            }
+
+            __attribute__((target("avx2"))) __m256i Avx2(__m256i v) const
+            {
+                __m256i stop = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(quote)),
+                                               _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\')));
+                return _mm256_andnot_si256(stop, _mm256_set1_epi8(-1));
+            }
+#endif
+        };
+
+        template <typename Class>
+        size_t RunLengthScalar(std::string_view text, size_t pos, const Class &cls)
+        {
+            while (pos < text.size() && cls(text[pos]))
+            {
+                ++pos;
+            }
+            return pos;
+        }
+
+#ifdef MYTHON_SCAN_X86
+        template <typename Class>
+        size_t RunLengthSse2(std::string_view text, const Class &cls)
+        {
+            size_t pos = 0;
+            for (; pos + 16 <= text.size(); pos += 16)
+            {
+                __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text.data() + pos));
+                unsigned mismatch = ~static_cast<unsigned>(_mm_movemask_epi8(cls.Sse2(block))) & 0xFFFFu;
+                if (mismatch)
+                {
+                    return pos + __builtin_ctz(mismatch);
+                }
+            }
+            return RunLengthScalar(text, pos, cls);
+        }
+
+        template <typename Class>
+        __attribute__((target("avx2"))) size_t RunLengthAvx2(std::string_view text, const Class &cls)
+        {
+            size_t pos = 0;
+            for (; pos + 32 <= text.size(); pos += 32)
+            {
+                __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text.data() + pos));
+                unsigned mismatch = ~static_cast<unsigned>(_mm256_movemask_epi8(cls.Avx2(block)));
+                if (mismatch)
+                {
+                    return pos + __builtin_ctz(mismatch);
+                }
+            }
+            // Хвост короче 32 байт добираем одним блоком SSE2 и побайтово
+            return pos + RunLengthSse2(text.substr(pos), cls);
+        }
+#endif
+
+        // Точная проверка UTF-8 с позиции pos, которая должна быть началом символа.
+        // Участки ASCII пропускаются по 8 байт
+        size_t Utf8ErrorScalar(std::string_view text, size_t pos)
+        {
+            const auto *data = reinterpret_cast<const unsigned char *>(text.data());
+            const size_t size = text.size();
+            while (pos < size)
+            {
+                if (pos + 8 <= size)
+                {
+                    uint64_t word;
+                    std::memcpy(&word, data + pos, sizeof(word));
+                    if (!(word & 0x8080808080808080ull))
+                    {
+                        pos += 8;
+                        continue;
+                    }
+                }
+
+                const unsigned char lead = data[pos];
+                if (lead < 0x80)
+                {
+                    ++pos;
+                    continue;
+                }
+
+                size_t length;
+                char32_t code;
+                char32_t min;
+                if ((lead & 0xE0) == 0xC0)
+                {
+                    length = 2, code = lead & 0x1F, min = 0x80;
+                }
+                else if ((lead & 0xF0) == 0xE0)
+                {
+                    length = 3, code = lead & 0x0F, min = 0x800;
+                }
+                else if ((lead & 0xF8) == 0xF0)
+                {
+                    length = 4, code = lead & 0x07, min = 0x10000;
+                }
+                else
+                {
+                    return pos;
+                }
+                if (length > size - pos)
+                {
+                    return pos;
+                }
+                for (size_t i = 1; i < length; ++i)
+                {
+                    if ((data[pos + i] & 0xC0) != 0x80)
+                    {
+                        return pos;
+                    }
+                    code = code << 6 | (data[pos + i] & 0x3F);
+                }
+                if (code < min || code > 0x10FFFF || (code >= 0xD800 && code <= 0xDFFF))
+                {
+                    return pos;
+                }
+                pos += length;
+            }
+            return size;
+        }
+
+#ifdef MYTHON_SCAN_X86
+        // До первого блока с байтом вне ASCII - SSE2, дальше - побайтово
+        size_t Utf8ErrorSse2(std::string_view text)
+        {
+            size_t pos = 0;
+            for (; pos + 16 <= text.size(); pos += 16)
+            {
+                __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text.data() + pos));
+                if (_mm_movemask_epi8(block))
+                {
+                    break;
+                }
+            }
+            return Utf8ErrorScalar(text, pos);
+        }
+
+        // Проверка UTF-8 таблицами по старшим и младшим полубайтам соседних байт
+        // (алгоритм lookup Кайзера и Лемира, как в simdjson). Каждый бит - вид ошибки:
+        // ошибка есть, если он выставлен во всех трёх таблицах
+        namespace utf8
+        {
+            constexpr uint8_t TOO_SHORT = 1 << 0;  // 11______ 0_______ или 11______ 11______
+            constexpr uint8_t TOO_LONG = 1 << 1;   // 0_______ 10______
+            constexpr uint8_t OVERLONG_3 = 1 << 2; // 11100000 100_____
+            constexpr uint8_t TOO_LARGE = 1 << 3;  // 11110100 1001____ и далее
+            constexpr uint8_t SURROGATE = 1 << 4;  // 11101101 101_____
+            constexpr uint8_t OVERLONG_2 = 1 << 5; // 1100000_ 10______
+            constexpr uint8_t TOO_LARGE_1000 = 1 << 6; // 11110101 1000____ и далее
+            constexpr uint8_t OVERLONG_4 = 1 << 6; // 11110000 1000____
+            constexpr uint8_t TWO_CONTS = 1 << 7;  // 10______ 10______
+            // Ошибки, для которых неважны младшие биты первого байта
+            constexpr uint8_t CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+            __attribute__((target("avx2"))) inline __m256i Table(const uint8_t (&t)[16])
+            {
+                __m128i half = _mm_loadu_si128(reinterpret_cast<const __m128i *>(t));
+                return _mm256_broadcastsi128_si256(half);
+            }
+
+            __attribute__((target("avx2"))) inline __m256i HighNibbles(__m256i v)
+            {
+                return _mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x0F));
+            }
+
+            // Байты input, сдвинутые на n позиций назад с подстановкой хвоста prev
+            template <int N>
+            __attribute__((target("avx2"))) inline __m256i Prev(__m256i input, __m256i prev)
+            {
+                return _mm256_alignr_epi8(input, _mm256_permute2x128_si256(prev, input, 0x21), 16 - N);
+            }
+
+            constexpr uint8_t BYTE_1_HIGH[16] = {
+                TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+                TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+                TOO_SHORT | OVERLONG_2,
+                TOO_SHORT,
+                TOO_SHORT | OVERLONG_3 | SURROGATE,
+                TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4};
+
+            constexpr uint8_t BYTE_1_LOW[16] = {
+                CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+                CARRY | OVERLONG_2,
+                CARRY,
+                CARRY,
+                CARRY | TOO_LARGE,
+                CARRY | TOO_LARGE | TOO_LARGE_1000,
+                CARRY | TOO_LARGE | TOO_LARGE_1000,
+                CARRY | TOO_LARGE | TOO_LARGE_1000,
+                CARRY | TOO_LARGE | TOO_LARGE_1000,
+                CARRY | TOO_LARGE | TOO_LARGE_1000,
+                CARRY | TOO_LARGE | TOO_LARGE_1000,
+                CARRY | TOO_LARGE | TOO_LARGE_1000,
+                CARRY | TOO_LARGE | TOO_LARGE_1000,
+                CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+                CARRY | TOO_LARGE | TOO_LARGE_1000,
+                CARRY | TOO_LARGE | TOO_LARGE_1000};
+
+            constexpr uint8_t BYTE_2_HIGH[16] = {
+                TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+                TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+                TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+                TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+                TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+                TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT};
+
+            // Ненулевые байты результата отмечают ошибки в input с учётом конца предыдущего блока prev
+            __attribute__((target("avx2"))) inline __m256i CheckBlock(__m256i input, __m256i prev)
+            {
+                const __m256i prev1 = Prev<1>(input, prev);
+                const __m256i special = _mm256_and_si256(
+                    _mm256_and_si256(_mm256_shuffle_epi8(Table(BYTE_1_HIGH), HighNibbles(prev1)),
+                                     _mm256_shuffle_epi8(Table(BYTE_1_LOW), _mm256_and_si256(prev1, _mm256_set1_epi8(0x0F)))),
+                    _mm256_shuffle_epi8(Table(BYTE_2_HIGH), HighNibbles(input)));
+
+                // Третий и четвёртый байты длинных последовательностей обязаны быть продолжениями
+                const __m256i third = _mm256_subs_epu8(Prev<2>(input, prev), _mm256_set1_epi8(static_cast<char>(0xE0 - 0x80)));
+                const __m256i fourth = _mm256_subs_epu8(Prev<3>(input, prev), _mm256_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+                const __m256i must_continue = _mm256_and_si256(_mm256_or_si256(third, fourth),
+                                                               _mm256_set1_epi8(static_cast<char>(0x80)));
+                return _mm256_xor_si256(must_continue, special);
+            }
+
+            // Ненулевые байты, если блок кончается посреди последовательности
+            __attribute__((target("avx2"))) inline __m256i Incomplete(__m256i input)
+            {
+                const __m256i max = _mm256_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                                     -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                                     static_cast<char>(0xF0 - 1), static_cast<char>(0xE0 - 1),
+                                                     static_cast<char>(0xC0 - 1));
+                return _mm256_subs_epu8(input, max);
+            }
+        } // namespace utf8
+
+        __attribute__((target("avx2"))) size_t Utf8ErrorAvx2(std::string_view text)
+        {
+            __m256i error = _mm256_setzero_si256();
+            __m256i prev = _mm256_setzero_si256();
+            __m256i prev_incomplete = _mm256_setzero_si256();
+            auto check = [&](__m256i block) __attribute__((target("avx2")))
+            {
+                if (_mm256_movemask_epi8(block) == 0)
+                {
+                    // Блок ASCII: ошибка, только если предыдущий оборвался посреди последовательности
+                    error = _mm256_or_si256(error, prev_incomplete);
+                }
+                else
+                {
+                    error = _mm256_or_si256(error, utf8::CheckBlock(block, prev));
+                    prev_incomplete = utf8::Incomplete(block);
+                }
+                prev = block;
+            };
+
+            size_t pos = 0;
+            for (; pos + 32 <= text.size(); pos += 32)
+            {
+                check(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(text.data() + pos)));
+            }
+            // Хвост дополняется нулями: это ASCII, так что оборванная в конце последовательность - ошибка
+            alignas(32) char tail[32] = {};
+            if (pos < text.size())
+            {
+                std::memcpy(tail, text.data() + pos, text.size() - pos);
+            }
+            check(_mm256_load_si256(reinterpret_cast<const __m256i *>(tail)));
+
+            if (_mm256_testz_si256(error, error))
+            {
+                return text.size();
+            }
+            // Ошибки редки, точную позицию ищем побайтово
+            return Utf8ErrorScalar(text, 0);
+        }
+#endif
+
+        Isa DetectIsa()
+        {
+#ifdef MYTHON_SCAN_X86
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") ? Isa::Avx2 : Isa::Sse2;
+#else
+            return Isa::Scalar;
+#endif
+        }
+
+        const Isa best_isa = DetectIsa();
+        std::atomic<Isa> active_isa = best_isa;
+
+        template <typename Class>
+        size_t RunLength(std::string_view text, const Class &cls)
+        {
+#ifdef MYTHON_SCAN_X86
+            // Лексемы в основном короткие и кончаются раньше, чем окупаются загрузка блока и выбор
+            // ядра, поэтому первые VECTOR_MIN_SIZE байт проходим побайтово
+            const size_t prefix = RunLengthScalar(text.substr(0, VECTOR_MIN_SIZE), 0, cls);
+            if (prefix < VECTOR_MIN_SIZE || prefix == text.size())
+            {
+                return prefix;
+            }
+            switch (active_isa.load(std::memory_order_relaxed))
+            {
+            case Isa::Avx2:
+                return prefix + RunLengthAvx2(text.substr(prefix), cls);
+            case Isa::Sse2:
+                return prefix + RunLengthSse2(text.substr(prefix), cls);
+            case Isa::Scalar:
+                break;
+            }
+            return RunLengthScalar(text, prefix, cls);
+#else
+            return RunLengthScalar(text, 0, cls);
+#endif
+        }
+    } // namespace
+
+    Isa ActiveIsa()
+    {
+        return active_isa.load(std::memory_order_relaxed);
+    }
+
+    Isa BestIsa()
+    {
+        return best_isa;
+    }
+
+    void SetIsa(Isa isa)
+    {
+        active_isa.store(isa <= best_isa ? isa : best_isa, std::memory_order_relaxed);
+    }
+
+    const char *IsaName(Isa isa)
+    {
+        switch (isa)
+        {
+        case Isa::Avx2:
+            return "avx2";
+        case Isa::Sse2:
+            return "sse2";
+        case Isa::Scalar:
+            break;
+        }
+        return "scalar";
+    }
+
+    size_t IdentifierLength(std::string_view text)
+    {
+        return RunLength(text, IdentifierClass{});
+    }
+
+    size_t DigitsLength(std::string_view text)
+    {
+        return RunLength(text, DigitClass{});
+    }
+
+    size_t SpacesLength(std::string_view text)
+    {
+        return RunLength(text, SpaceClass{});
+    }
+
+    size_t IndentLength(std::string_view text)
+    {
+        return RunLength(text, IndentClass{});
+    }
+
+    size_t FindQuoteOrBackslash(std::string_view text, char quote)
+    {
+        return RunLength(text, StringBodyClass{quote});
+    }
+
+    size_t Utf8ErrorPosition(std::string_view text)
+    {
+#ifdef MYTHON_SCAN_X86
+        switch (active_isa.load(std::memory_order_relaxed))
+        {
+        case Isa::Avx2:
+            return Utf8ErrorAvx2(text);
+        case Isa::Sse2:
+            return Utf8ErrorSse2(text);
+        case Isa::Scalar:
+            break;
+        }
+#endif
+        return Utf8ErrorScalar(text, 0);
+    }
+
+    char32_t DecodeUtf8(std::string_view text, size_t &pos)
+    {
+        const auto lead = static_cast<unsigned char>(text[pos++]);
+        if (lead < 0x80)
+        {
+            return lead;
+        }
+        const size_t continuations = lead >= 0xF0 ? 3 : lead >= 0xE0 ? 2 : 1;
+        char32_t code = lead & (0x3F >> continuations);
+        for (size_t i = 0; i < continuations; ++i)
+        {
+            code = code << 6 | (static_cast<unsigned char>(text[pos++]) & 0x3F);
+        }
+        return code;
+    }
+
+    bool IsIdentifierCodePoint(char32_t c)
+    {
+        if (c < 0x100)
+        {
+            // Из Latin-1 - буквы и знаки ª µ º, кроме × и ÷
+            return c >= 0xC0 ? c != 0xD7 && c != 0xF7 : c == 0xAA || c == 0xB5 || c == 0xBA;
+        }
+        return !(c >= 0x2000 && c <= 0x206F)     // пробелы и знаки пунктуации
+               && !(c >= 0x2190 && c <= 0x2BFF)  // стрелки, математические знаки, рамки, фигуры
+               && !(c >= 0x3000 && c <= 0x303F)  // пунктуация CJK
+               && !(c >= 0xD800 && c <= 0xDFFF)  // суррогаты
+               && !(c >= 0xFE10 && c <= 0xFE1F)  // вертикальные формы
+               && !(c >= 0xFF00 && c <= 0xFF0F)  // полноширинная пунктуация
+               && c != 0xFEFF                    // метка порядка байт
+               && !(c >= 0xFFF0 && c <= 0xFFFF); // служебные
+    }
+
+} // namespace parse::scan
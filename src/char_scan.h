@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+// Поиск границ лексем по классам символов ASCII и проверка UTF-8.
+// Не зависит от локали. На x86-64 блоки по 16/32 байта обрабатываются SSE2/AVX2,
+// набор инструкций выбирается один раз при запуске; на прочих платформах - побайтово
+namespace parse::scan
+{
+
+    enum class Isa
+    {
+        Scalar,
+        Sse2,
+        Avx2,
+    };
+
+    // Первые VECTOR_MIN_SIZE байт серии функции поиска проходят побайтово при любом наборе
+    // инструкций; векторное ядро включается, только если серия на них не кончилась
+    inline constexpr size_t VECTOR_MIN_SIZE = 32;
+
+    // Набор инструкций, которым сейчас пользуются функции поиска
+    Isa ActiveIsa();
+    // Самый быстрый набор, доступный процессору
+    Isa BestIsa();
+    // Переключает реализацию (для тестов и бенчмарков). Недоступный набор заменяется лучшим доступным
+    void SetIsa(Isa isa);
+    const char *IsaName(Isa isa);
+
+    // Длина префикса text из символов [A-Za-z0-9_]
+    size_t IdentifierLength(std::string_view text);
+    // Длина префикса text из цифр
+    size_t DigitsLength(std::string_view text);
+    // Длина префикса text из пробельных символов " \t\n\v\f\r"
+    size_t SpacesLength(std::string_view text);
+    // Длина префикса text из символов отступа " \t\n"
+    size_t IndentLength(std::string_view text);
+    // Позиция первого символа quote или '\\' в text, либо text.size()
+    size_t FindQuoteOrBackslash(std::string_view text, char quote);
+    // Позиция начала первой некорректной последовательности UTF-8 в text, либо text.size().
+    // Некорректны обрывки последовательностей, избыточно длинные записи, суррогаты и коды
+    // больше U+10FFFF. Блоки из одного ASCII проверяются без разбора последовательностей
+    size_t Utf8ErrorPosition(std::string_view text);
+
+    // Раскодирует символ корректного UTF-8, начинающийся в text[pos], и сдвигает pos за него
+    char32_t DecodeUtf8(std::string_view text, size_t &pos);
+
+    // Может ли символ вне ASCII входить в идентификатор. Приближение XID_Continue без таблиц
+    // Unicode: подходят все символы, кроме управляющих, пробелов, знаков пунктуации и служебных
+    // из основных блоков (Latin-1, General Punctuation, стрелки и математические знаки, CJK)
+    bool IsIdentifierCodePoint(char32_t c);
+
+    inline bool IsAscii(char c)
+    {
+        return static_cast<unsigned char>(c) < 0x80;
+    }
+
+    inline bool IsDigit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    inline bool IsAlpha(char c)
+    {
+        return (c | 0x20) >= 'a' && (c | 0x20) <= 'z';
+    }
+
+    inline bool IsIdentifierChar(char c)
+    {
+        return IsAlpha(c) || IsDigit(c) || c == '_';
+    }
+
+    inline bool IsSpace(char c)
+    {
+        return c == ' ' || (c >= '\t' && c <= '\r');
+    }
+
+    // Печатный символ ASCII, не являющийся буквой или цифрой (как std::ispunct в локали "C")
+    inline bool IsPunct(char c)
+    {
+        return c > ' ' && c < 0x7F && !IsAlpha(c) && !IsDigit(c);
+    }
+
+} // namespace parse::scan
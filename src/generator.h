@@ -0,0 +1,149 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <utility>
+
+namespace parse
+{
+
+    // Ленивая последовательность значений T, вычисляемая сопрограммой (аналог std::generator из C++23).
+    // Значение вычисляется при продвижении итератора; сопрограмма выполняется в потоке потребителя.
+    // Исключение сопрограммы выбрасывается из begin() или operator++ итератора
+    template <typename T>
+    class Generator
+    {
+    public:
+        struct promise_type
+        {
+            Generator get_return_object()
+            {
+                return Generator(std::coroutine_handle<promise_type>::from_promise(*this));
+            }
+
+            std::suspend_always initial_suspend() noexcept
+            {
+                return {};
+            }
+
+            std::suspend_always final_suspend() noexcept
+            {
+                return {};
+            }
+
+            // Временный объект выражения co_yield живёт до возобновления сопрограммы,
+            // поэтому значение не копируется, а запоминается его адрес
+            std::suspend_always yield_value(T &value) noexcept
+            {
+                value_ = std::addressof(value);
+                return {};
+            }
+
+            std::suspend_always yield_value(T &&value) noexcept
+            {
+                value_ = std::addressof(value);
+                return {};
+            }
+
+            void return_void() noexcept {}
+
+            void unhandled_exception() noexcept
+            {
+                error_ = std::current_exception();
+            }
+
+            T *value_ = nullptr;
+            std::exception_ptr error_;
+        };
+
+        class Iterator
+        {
+        public:
+            using iterator_category = std::input_iterator_tag;
+            using value_type = T;
+            using difference_type = std::ptrdiff_t;
+            using pointer = T *;
+            using reference = T &;
+
+            Iterator() = default;
+            explicit Iterator(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+
+            reference operator*() const
+            {
+                return *handle_.promise().value_;
+            }
+
+            pointer operator->() const
+            {
+                return handle_.promise().value_;
+            }
+
+            Iterator &operator++()
+            {
+                Resume(handle_);
+                return *this;
+            }
+
+            void operator++(int)
+            {
+                ++*this;
+            }
+
+            bool operator==(std::default_sentinel_t) const
+            {
+                return !handle_ || handle_.done();
+            }
+
+        private:
+            std::coroutine_handle<promise_type> handle_;
+        };
+
+        Generator(const Generator &) = delete;
+        Generator &operator=(const Generator &) = delete;
+
+        Generator(Generator &&other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+
+        Generator &operator=(Generator &&other) noexcept
+        {
+            std::swap(handle_, other.handle_);
+            return *this;
+        }
+
+        ~Generator()
+        {
+            if (handle_)
+            {
+                handle_.destroy();
+            }
+        }
+
+        // Запускает сопрограмму до первого значения. Вызывается один раз
+        Iterator begin()
+        {
+            Resume(handle_);
+            return Iterator(handle_);
+        }
+
+        std::default_sentinel_t end() const noexcept
+        {
+            return {};
+        }
+
+    private:
+        explicit Generator(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+
+        static void Resume(std::coroutine_handle<promise_type> handle)
+        {
+            handle.resume();
+            if (handle.done() && handle.promise().error_)
+            {
+                std::rethrow_exception(std::exchange(handle.promise().error_, {}));
+            }
+        }
+
+        std::coroutine_handle<promise_type> handle_;
+    };
+
+} // namespace parse
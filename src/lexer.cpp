@@ -1,13 +1,32 @@
 #include "lexer.h"
 
+#include "char_scan.h"
+#include "token_stream.h"
+
 #include <algorithm>
+#include <atomic>
 #include <charconv>
-#include <unordered_map>
-#include <unordered_set>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <thread>
+#include <utility>
 #include <vector>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 using namespace std;
 
+#ifdef MYTHON_LEXER_STATS
+#define MYTHON_LEXER_STAT(statement) statement
+#else
+#define MYTHON_LEXER_STAT(statement)
+#endif
+
 namespace parse
 {
 
@@ -27,6 +46,10 @@ namespace parse
         {
             return lhs.As<Number>().value == rhs.As<Number>().value;
         }
+        if (lhs.Is<BigNumber>())
+        {
+            return lhs.As<BigNumber>().value == rhs.As<BigNumber>().value;
+        }
         if (lhs.Is<String>())
         {
             return lhs.As<String>().value == rhs.As<String>().value;
@@ -43,6 +66,111 @@ namespace parse
         return !(lhs == rhs);
     }
 
+    const char *TokenKindName(size_t kind)
+    {
+        static constexpr const char *names[] = {
+            "Number", "Id", "Char", "String", "Class", "Return", "If", "Else",
+            "Def", "Newline", "Print", "Indent", "Dedent", "And", "Or", "Not",
+            "Eq", "NotEq", "LessOrEq", "GreaterOrEq", "None", "True", "False", "Eof",
+            "BigNumber"};
+        static_assert(std::size(names) == std::variant_size_v<TokenBase>);
+
+        return kind < std::size(names) ? names[kind] : "Unknown";
+    }
+
+    uint64_t LexerStats::TotalTokens() const
+    {
+        uint64_t total = 0;
+        for (auto count : tokens)
+        {
+            total += count;
+        }
+        return total;
+    }
+
+    void LexerStats::AddTokens(const TokenCounts &counts)
+    {
+        for (size_t i = 0; i < tokens.size(); ++i)
+        {
+            tokens[i] += counts[i];
+        }
+    }
+
+    void LexerStats::Merge(const LexerStats &other)
+    {
+        AddTokens(other.tokens);
+        lines += other.lines;
+        bytes += other.bytes;
+        escape_decodes += other.escape_decodes;
+        keyword_misses += other.keyword_misses;
+        load_time += other.load_time;
+        tokenize_time += other.tokenize_time;
+    }
+
+    std::ostream &operator<<(std::ostream &os, const LexerStats &stats)
+    {
+        using Ms = std::chrono::duration<double, std::milli>;
+
+        const double tokenize_seconds = std::chrono::duration<double>(stats.tokenize_time).count();
+        os << "lines: " << stats.lines << '\n'
+           << "bytes: " << stats.bytes << '\n'
+           << "tokens: " << stats.TotalTokens() << '\n'
+           << "escape decodes: " << stats.escape_decodes << '\n'
+           << "keyword misses: " << stats.keyword_misses << '\n'
+           << "load time: " << Ms(stats.load_time).count() << " ms\n"
+           << "tokenize time: " << Ms(stats.tokenize_time).count() << " ms\n";
+        if (tokenize_seconds > 0)
+        {
+            os << "throughput: " << stats.bytes / tokenize_seconds / (1 << 20) << " MB/s, "
+               << stats.TotalTokens() / tokenize_seconds / 1e6 << " Mtokens/s\n";
+        }
+        for (size_t kind = 0; kind < stats.tokens.size(); ++kind)
+        {
+            if (stats.tokens[kind])
+            {
+                os << "  " << TokenKindName(kind) << ": " << stats.tokens[kind] << '\n';
+            }
+        }
+        return os;
+    }
+
+    namespace
+    {
+#ifdef MYTHON_LEXER_STATS
+        // Добавляет к total время жизни объекта
+        class PhaseTimer
+        {
+        public:
+            explicit PhaseTimer(std::chrono::nanoseconds &total)
+                : total_(total), start_(std::chrono::steady_clock::now()) {}
+
+            PhaseTimer(const PhaseTimer &) = delete;
+            PhaseTimer &operator=(const PhaseTimer &) = delete;
+
+            ~PhaseTimer()
+            {
+                total_ += std::chrono::steady_clock::now() - start_;
+            }
+
+        private:
+            std::chrono::nanoseconds &total_;
+            std::chrono::steady_clock::time_point start_;
+        };
+#endif
+    } // namespace
+
+    LexerError::LexerError(const std::string &message, size_t line, size_t column)
+        : std::runtime_error("line " + std::to_string(line) + ", column " + std::to_string(column) + ": " + message),
+          line_(line), column_(column)
+    {
+    }
+
+    LexerError::LexerError(const LexerDiagnostic &diagnostic)
+        : LexerError(diagnostic.line ? LexerError(diagnostic.message, diagnostic.line, diagnostic.column)
+                                     : LexerError(diagnostic.message))
+    {
+    }
+
     std::ostream &operator<<(std::ostream &os, const Token &rhs)
     {
         using namespace token_type;
@@ -52,6 +180,7 @@ namespace parse
         return os << #type << '{' << p->value << '}';
 
         VALUED_OUTPUT(Number);
+        VALUED_OUTPUT(BigNumber);
         VALUED_OUTPUT(Id);
         VALUED_OUTPUT(String);
         VALUED_OUTPUT(Char);
@@ -88,79 +217,148 @@ namespace parse
         return os << "Unknown token :("sv;
     }
 
-    std::string Unescape(const std::string &str)
+    namespace
     {
-        std::string result;
-        result.reserve(str.size());
-        for (size_t i = 0; i < str.size(); ++i)
+        // Приёмники раскодированной строки: собственная строка токена или память арены
+        struct StringSink
         {
-            if (str[i] == '\\' && i + 1 < str.size())
+            std::string &value;
+
+            void Append(std::string_view text)
             {
-                switch (str[++i])
-                {
-                case '\"':
-                    result += '\"';
-                    break;
-                case '\'':
-                    result += '\'';
-                    break;
-                case 't':
-                    result += '\t';
-                    break;
-                case 'n':
-                    result += '\n';
-                    break;
-                case '\\':
-                    result += '\\';
-                    break;
-                default:
-                    result += '\\';
-                    result += str[i];
-                    break;
-                }
+                value.append(text);
             }
-            else
+
+            void Push(char c)
+            {
+                value.push_back(c);
+            }
+        };
+
+        struct ArenaSink
+        {
+            char *end;
+
+            void Append(std::string_view text)
             {
-                result += str[i];
+                end = std::copy(text.begin(), text.end(), end);
             }
+
+            void Push(char c)
+            {
+                *end++ = c;
+            }
+        };
+
+        // Пишет в sink символ, обозначаемый escape-последовательностью с символом c после обратной косой черты
+        template <typename Sink>
+        void DecodeEscape(char c, Sink &sink)
+        {
+            switch (c)
+            {
+            case '\"':
+                sink.Push('\"');
+                break;
+            case '\'':
+                sink.Push('\'');
+                break;
+            case 't':
+                sink.Push('\t');
+                break;
+            case 'n':
+                sink.Push('\n');
+                break;
+            case '\\':
+                sink.Push('\\');
+                break;
+            default:
+                sink.Push('\\');
+                sink.Push(c);
+                break;
+            }
+        }
+    } // namespace
+
+    char *StringArena::Reserve(size_t size)
+    {
+        if (capacity_ - used_ < size)
+        {
+            capacity_ = std::max(size, CHUNK_SIZE);
+            chunks_.push_back(std::make_unique<char[]>(capacity_));
+            used_ = 0;
         }
+        return chunks_.back().get() + used_;
+    }
+
+    void StringArena::Commit(size_t size)
+    {
+        used_ += size;
+    }
+
+    char *StringArena::Allocate(size_t size)
+    {
+        char *result = Reserve(size);
+        Commit(size);
         return result;
     }
 
     //=============================Tokenazer=====================================
+    // Разбирает одну строку, выдавая токены по одному через Next
     class Tokenazer_Base
     {
     public:
-        static uint32_t GetIndentLevel()
-        {
-            return Tokenazer_Base::intend_level_;
-        }
-
-        static void EraseIndent()
+        // intend_level - уровень отступа, который владелец переносит от строки к строке,
+        // line_number - номер строки buff в источнике для сообщений об ошибках.
+        // Если задан arena, String ссылаются на buff_, а раскодированные строки кладутся в arena.
+        // Имена Id интернируются через symbols.
+        // Если задан stats, в него пишутся счётчики (при сборке с MYTHON_LEXER_STATS)
+        Tokenazer_Base(std::string_view buff, uint32_t &intend_level, size_t line_number, symbols::SymbolCache &symbols,
+                       StringArena *arena = nullptr, [[maybe_unused]] LexerStats *stats = nullptr)
+            : buff_(buff), line_(buff), line_number_(line_number), intend_level_(intend_level), symbols_(symbols),
+              arena_(arena)
+#ifdef MYTHON_LEXER_STATS
+              ,
+              stats_(stats)
+#endif
         {
-            Tokenazer_Base::intend_level_ = 0;
         }
 
-    protected:
-        Tokenazer_Base(std::string_view buff) : buff_(buff) {}
-        virtual void PushToOutput(Token &&) = 0;
-        virtual ~Tokenazer_Base() = default;
-
-        void HandleCode()
+        // Записывает в token очередной токен строки. Возвращает false, когда строка разобрана
+        // или в ней найдена ошибка (см. Error). Исключений при ошибках в тексте не выбрасывает
+        bool Next(Token &token)
         {
-            if (buff_[0] == '#')
+            if (!started_)
             {
-                HandleComment();
-                return;
+                started_ = true;
+                // Строка целиком должна быть корректным UTF-8, включая строковые литералы и комментарии
+                if (const size_t invalid = scan::Utf8ErrorPosition(buff_); invalid != buff_.size())
+                {
+                    buff_.remove_prefix(invalid);
+                    Fail("Invalid UTF-8 sequence");
+                    return false;
+                }
+                if (buff_[0] == '#')
+                {
+                    HandleComment();
+                    finished_ = true;
+                    return false;
+                }
+                HandleIntend();
             }
 
-            auto tokens = HandleIntend();
-            if (!tokens.empty())
+            // Indent и Dedent относятся к первому символу строки после отступа, Newline - к её концу
+            token_column_ = Column();
+            if (pending_indents_ > 0)
             {
-                for (auto &token : tokens)
-                {
-                    PushToOutput(std::move(token));
-                }
+                --pending_indents_;
+                token = token_type::Indent{};
+                return true;
+            }
+            if (pending_indents_ < 0)
+            {
+                ++pending_indents_;
+                token = token_type::Dedent{};
+                return true;
             }
 
             while (!buff_.empty())
@@ -171,103 +369,153 @@ namespace parse
                     continue;
                 }
 
-                if (std::isspace(buff_[0]))
+                if (scan::IsSpace(buff_[0]))
                 {
-                    auto space_count = buff_.find_first_not_of(" \n\t");
-                    buff_.remove_prefix(space_count == std::string::npos ? buff_.size() : space_count);
+                    buff_.remove_prefix(scan::SpacesLength(buff_));
+                    continue;
                 }
-                else if (std::isalpha(buff_[0]) || buff_[0] == '_')
+
+                token_column_ = Column();
+                if (scan::IsAlpha(buff_[0]) || buff_[0] == '_')
                 {
-                    PushToOutput(HandleWord());
+                    token = HandleWord();
                 }
-                else if (std::isdigit(buff_[0]))
+                else if (scan::IsDigit(buff_[0]))
                 {
-                    PushToOutput(HandleNumber());
+                    token = HandleNumber();
                 }
                 else if (buff_[0] == '"' || buff_[0] == '\'')
                 {
-                    PushToOutput(HandleString());
+                    token = HandleString();
+                }
+                else if (!scan::IsAscii(buff_[0]))
+                {
+                    token = HandleNonAscii();
                 }
-                else if (std::ispunct(buff_[0]))
+                else
                 {
-                    PushToOutput(HandleOperator());
+                    token = HandleOperator();
                 }
+                return !error_;
+            }
+
+            if (finished_)
+            {
+                return false;
             }
-            PushToOutput(Token{token_type::Newline{}});
+            finished_ = true;
+            token_column_ = Column();
+            token = token_type::Newline{};
+            return true;
+        }
+
+        // Первая ошибка в строке; после неё Next возвращает false
+        [[nodiscard]] const std::optional<LexerDiagnostic> &Error() const
+        {
+            return error_;
+        }
+
+        // Позиция начала токена, последним записанного Next
+        [[nodiscard]] SourceLocation TokenLocation() const
+        {
+            return {static_cast<uint32_t>(line_number_), token_column_};
         }
 
     private:
-        std::vector<Token> HandleIntend()
+        // Столбец текущей позиции разбора
+        [[nodiscard]] uint32_t Column() const
         {
-            std::vector<Token> tokens;
-            uint32_t curr_inten_lvl = 0;
+            return static_cast<uint32_t>(buff_.data() - line_.data() + 1);
+        }
 
-            auto space_count = buff_.find_first_not_of(" \n\t");
-            if (space_count == std::string::npos)
+        // Запоминает ошибку в текущей позиции и прекращает разбор строки
+        Token Fail(std::string message)
+        {
+            error_ = LexerDiagnostic{std::move(message), line_number_, Column()};
+            buff_ = {};
+            finished_ = true;
+            return {};
+        }
+
+        // Переводит intend_level_ на уровень строки и запоминает, сколько Indent/Dedent выдать
+        void HandleIntend()
+        {
+            auto space_count = scan::IndentLength(buff_);
+            if (space_count == buff_.size())
             {
-                return tokens;
+                return;
             }
 
-            curr_inten_lvl = space_count / 2;
+            const uint32_t curr_inten_lvl = space_count / 2;
             buff_.remove_prefix(space_count);
 
-            if (curr_inten_lvl > intend_level_)
-            {
-                auto diff = curr_inten_lvl - intend_level_;
-                tokens.resize(diff, Token{token_type::Indent{}});
-            }
-            else if (curr_inten_lvl < intend_level_)
-            {
-                auto diff = intend_level_ - curr_inten_lvl;
-                tokens.resize(diff, Token{token_type::Dedent{}});
-            }
-
+            pending_indents_ = static_cast<int64_t>(curr_inten_lvl) - intend_level_;
             intend_level_ = curr_inten_lvl;
-            return tokens;
         }
 
         Token HandleWord()
         {
             Token token;
-            size_t end_pos = 0;
-
-            while (buff_.size() > end_pos && (std::isalnum(buff_[end_pos]) || buff_[end_pos] == '_'))
+            // Участки ASCII размечает сканер, символы вне ASCII между ними разбираются по одному
+            size_t end_pos = scan::IdentifierLength(buff_);
+            while (end_pos < buff_.size() && !scan::IsAscii(buff_[end_pos]))
             {
-                ++end_pos;
+                size_t next = end_pos;
+                if (!scan::IsIdentifierCodePoint(scan::DecodeUtf8(buff_, next)))
+                {
+                    break;
+                }
+                end_pos = next + scan::IdentifierLength(buff_.substr(next));
             }
+            auto word = buff_.substr(0, end_pos);
 
-            std::string word(buff_.substr(0, end_pos));
-            buff_.remove_prefix(end_pos);
-
-            auto it = keywords_.find(word);
-            if (it != keywords_.end())
+            if (!MatchKeyword(word, token))
             {
-                token = it->second;
-            }
-            else
-            {
-                token = token_type::Id{std::move(word)};
+                token = token_type::Id{symbols_.Intern(word)};
+                MYTHON_LEXER_STAT(if (stats_) ++stats_->keyword_misses);
             }
+            buff_.remove_prefix(end_pos);
 
             return token;
         }
 
-        Token HandleNumber()
+        // Символ вне ASCII начинает идентификатор, если он буква (см. scan::IsIdentifierCodePoint)
+        Token HandleNonAscii()
         {
-            Token token;
+            using namespace std::literals;
 
-            size_t end_pos = 0;
-            while (buff_.size() > end_pos && std::isdigit(buff_[end_pos]))
+            size_t length = 0;
+            if (scan::IsIdentifierCodePoint(scan::DecodeUtf8(buff_, length)))
             {
-                ++end_pos;
+                return HandleWord();
             }
+            return Fail("Unexpected character "s + std::string(buff_.substr(0, length)));
+        }
+
+        // Литерал, не помещающийся в int, становится BigNumber, не помещающийся в int64_t - ошибкой
+        Token HandleNumber()
+        {
+            using namespace std::literals;
 
-            token = token_type::Number{std::stoi(std::string(buff_.substr(0, end_pos)))};
+            const size_t end_pos = scan::DigitsLength(buff_);
+            int64_t value = 0;
+            auto [end, error] = std::from_chars(buff_.data(), buff_.data() + end_pos, value);
+            if (error == std::errc::result_out_of_range)
+            {
+                return Fail("Number literal "s + std::string(buff_.substr(0, end_pos)) + " is out of range"s);
+            }
             buff_.remove_prefix(end_pos);
 
-            return token;
+            if (value > std::numeric_limits<int>::max())
+            {
+                return token_type::BigNumber{value};
+            }
+            return token_type::Number{static_cast<int>(value)};
         }
 
+        // Больший буфер раскодирования строк освобождается после использования
+        static constexpr size_t MAX_DECODE_BUFFER = 64 * 1024;
+
         Token HandleString()
         {
             Token token;
@@ -275,105 +523,214 @@ namespace parse
             char sep = buff_[0];
             buff_.remove_prefix(1);
 
-            size_t end_pos = 0;
-            bool has_escape = false;
-            while (buff_.size() > 0 && buff_[end_pos] != sep)
+            // Строка без escape-последовательностей берётся из буфера как есть
+            size_t end_pos = scan::FindQuoteOrBackslash(buff_, sep);
+            if (end_pos == buff_.size() || buff_[end_pos] == sep)
             {
-                if (buff_[end_pos] == '\\')
+                auto text = buff_.substr(0, end_pos);
+                token = arena_ ? token_type::String{TokenText(text)} : token_type::String{std::string(text)};
+            }
+            else if (arena_)
+            {
+                MYTHON_LEXER_STAT(if (stats_) ++stats_->escape_decodes);
+                // Раскодированная строка не длиннее исходной, поэтому хватает места под остаток строки
+                char *begin = arena_->Reserve(buff_.size());
+                ArenaSink sink{begin};
+                end_pos = DecodeString(end_pos, sep, sink);
+                arena_->Commit(sink.end - begin);
+                token = token_type::String{TokenText(std::string_view(begin, sink.end - begin))};
+            }
+            else
+            {
+                MYTHON_LEXER_STAT(if (stats_) ++stats_->escape_decodes);
+                // Буфер раскодирования переиспользуется, так что строка токена получает
+                // память ровно по длине за одно выделение (или не выделяет её вовсе, если короткая)
+                thread_local std::string decoded;
+                decoded.clear();
+                StringSink sink{decoded};
+                end_pos = DecodeString(end_pos, sep, sink);
+                token = token_type::String{std::string(decoded)};
+                if (decoded.capacity() > MAX_DECODE_BUFFER)
                 {
-                    has_escape = true;
-                    ++end_pos;
+                    std::string().swap(decoded);
                 }
-                ++end_pos;
             }
 
-            token = token_type::String{
-                has_escape ? Unescape(std::string(buff_.substr(0, end_pos))) : std::string(buff_.substr(0, end_pos))};
-
-            buff_.remove_prefix(++end_pos);
+            buff_.remove_prefix(std::min(end_pos + 1, buff_.size()));
 
             return token;
         }
 
+        // Раскодирует строку за тот же проход, которым ищется закрывающая кавычка sep.
+        // pos - позиция первой обратной косой черты: текст до неё, а затем отрезки между
+        // escape-последовательностями пишутся в sink. Возвращает позицию кавычки
+        // (buff_.size(), если строка не закрыта)
+        template <typename Sink>
+        size_t DecodeString(size_t pos, char sep, Sink &sink)
+        {
+            sink.Append(buff_.substr(0, pos));
+            while (pos < buff_.size() && buff_[pos] != sep)
+            {
+                // Обратная косая черта в конце незакрытой строки остаётся как есть
+                if (pos + 1 == buff_.size())
+                {
+                    sink.Push('\\');
+                    return buff_.size();
+                }
+                DecodeEscape(buff_[pos + 1], sink);
+                pos += 2;
+                const size_t next = pos + scan::FindQuoteOrBackslash(buff_.substr(pos), sep);
+                sink.Append(buff_.substr(pos, next - pos));
+                pos = next;
+            }
+            return pos;
+        }
+
         Token HandleOperator()
         {
             Token token;
 
-            if (std::ispunct(buff_[1]))
+            char next = buff_.size() > 1 ? buff_[1] : '\0';
+            if (next == '=' && MatchComparison(buff_[0], token))
             {
-                std::string op{buff_.substr(0, 2)};
-                auto it = operators_.find(op);
-                if (it != operators_.end())
-                {
-                    token = it->second;
-                    buff_.remove_prefix(2);
-                    return token;
-                }
+                buff_.remove_prefix(2);
+                return token;
             }
 
-            token = operators_.at(std::string{buff_[0]});
+            switch (buff_[0])
+            {
+            case '+':
+            case '-':
+            case '*':
+            case '/':
+            case '.':
+            case ',':
+            case '(':
+            case ')':
+            case '<':
+            case '>':
+            case '=':
+            case ':':
+                token = token_type::Char{buff_[0]};
+                break;
+            default:
+                return Fail("Unknown operator "s + buff_[0]);
+            }
             buff_.remove_prefix(1);
 
             return token;
         }
 
-        void HandleComment()
+        // Двухсимвольные операторы вида «c=»
+        static bool MatchComparison(char c, Token &token)
         {
-            buff_.remove_prefix(buff_.size());
+            switch (c)
+            {
+            case '=':
+                token = token_type::Eq{};
+                return true;
+            case '!':
+                token = token_type::NotEq{};
+                return true;
+            case '<':
+                token = token_type::LessOrEq{};
+                return true;
+            case '>':
+                token = token_type::GreaterOrEq{};
+                return true;
+            default:
+                return false;
+            }
         }
 
-        bool is_key_sign(char c) const
+        // Распознаёт ключевое слово без хеш-таблицы: выбор по длине и первому символу,
+        // затем одно сравнение строк
+        static bool MatchKeyword(std::string_view word, Token &token)
         {
-            return key_sign_.find(c) != key_sign_.end();
+            using namespace std::literals;
+
+            auto match = [&](std::string_view keyword, Token keyword_token)
+            {
+                if (word != keyword)
+                {
+                    return false;
+                }
+                token = std::move(keyword_token);
+                return true;
+            };
+
+            switch (word.size())
+            {
+            case 2:
+                return word[0] == 'i' ? match("if"sv, token_type::If{})
+                                      : match("or"sv, token_type::Or{});
+            case 3:
+                switch (word[0])
+                {
+                case 'd':
+                    return match("def"sv, token_type::Def{});
+                case 'a':
+                    return match("and"sv, token_type::And{});
+                case 'n':
+                    return match("not"sv, token_type::Not{});
+                default:
+                    return false;
+                }
+            case 4:
+                switch (word[0])
+                {
+                case 'e':
+                    return match("else"sv, token_type::Else{});
+                case 'N':
+                    return match("None"sv, token_type::None{});
+                case 'T':
+                    return match("True"sv, token_type::True{});
+                default:
+                    return false;
+                }
+            case 5:
+                switch (word[0])
+                {
+                case 'c':
+                    return match("class"sv, token_type::Class{});
+                case 'p':
+                    return match("print"sv, token_type::Print{});
+                case 'F':
+                    return match("False"sv, token_type::False{});
+                default:
+                    return false;
+                }
+            case 6:
+                return match("return"sv, token_type::Return{});
+            default:
+                return false;
+            }
         }
 
-        bool is_operator_sign(const std::string &buff) const
+        void HandleComment()
         {
-            return operators_.find(buff) != operators_.end();
+            buff_.remove_prefix(buff_.size());
         }
 
         std::string_view buff_;
-        static uint32_t intend_level_;
-        static const std::unordered_map<std::string, Token> keywords_;
-        static const std::unordered_set<char> key_sign_;
-        static const std::unordered_map<std::string, Token> operators_;
-    }; // end of class Tokenazer_Base
-    uint32_t Tokenazer_Base::intend_level_ = 0;
-    const std::unordered_map<std::string, Token> Tokenazer_Base::keywords_ =
-        {
-            {"class", token_type::Class{}},
-            {"return", token_type::Return{}},
-            {"if", token_type::If{}},
-            {"else", token_type::Else{}},
-            {"def", token_type::Def{}},
-            {"print", token_type::Print{}},
-            {"and", token_type::And{}},
-            {"or", token_type::Or{}},
-            {"not", token_type::Not{}},
-            {"None", token_type::None{}},
-            {"True", token_type::True{}},
-            {"False", token_type::False{}},
-    };
-    const std::unordered_map<std::string, Token> Tokenazer_Base::operators_ =
-        {
-            {"==", token_type::Eq{}},
-            {"!=", token_type::NotEq{}},
-            {"<=", token_type::LessOrEq{}},
-            {">=", token_type::GreaterOrEq{}},
-            {"+", token_type::Char{'+'}},
-            {"-", token_type::Char{'-'}},
-            {"*", token_type::Char{'*'}},
-            {"/", token_type::Char{'/'}},
-            {".", token_type::Char{'.'}},
-            {",", token_type::Char{','}},
-            {"(", token_type::Char{'('}},
-            {")", token_type::Char{')'}},
-            {"<", token_type::Char{'<'}},
-            {">", token_type::Char{'>'}},
-            {"=", token_type::Char{'='}},
-            {":", token_type::Char{':'}},
-    };
+        // Вся строка и её номер, для позиции в сообщениях об ошибках
+        std::string_view line_;
+        size_t line_number_;
+        uint32_t &intend_level_;
+        symbols::SymbolCache &symbols_;
+        StringArena *arena_;
+        // Сколько Indent (> 0) или Dedent (< 0) осталось выдать перед токенами строки
+        int64_t pending_indents_ = 0;
+        uint32_t token_column_ = 0;
+        bool started_ = false;
+        bool finished_ = false;
+        std::optional<LexerDiagnostic> error_;
 
+    protected:
+#ifdef MYTHON_LEXER_STATS
+        LexerStats *stats_;
+#endif
+    }; // end of class Tokenazer_Base
     template <typename T>
     concept T_has_put_to_output = requires(T &obj) {
         { obj.push_back(std::declval<Token>()) };
@@ -384,56 +741,1002 @@ namespace parse
     class Tokenazer final : private parse::Tokenazer_Base
     {
     public:
-        Tokenazer(std::string_view buff, T &output)
-            : parse::Tokenazer_Base(buff), output_(output) {}
-        void PushToOutput(Token &&token) override
-        {
-            output_.push_back(std::forward<Token>(token));
-        }
+        // Если задан locations, в него пишутся позиции токенов, дописанных в output
+        Tokenazer(std::string_view buff, T &output, uint32_t &intend_level, size_t line_number,
+                  symbols::SymbolCache &symbols, StringArena *arena = nullptr, LexerStats *stats = nullptr,
+                  TokenLocations *locations = nullptr)
+            : parse::Tokenazer_Base(buff, intend_level, line_number, symbols, arena, stats), output_(output),
+              locations_(locations) {}
+
+        using Tokenazer_Base::Error;
 
-        void HandleCode()
+        // Разбирает строку в конец output. При ошибке возвращает false; токены,
+        // выданные до неё, остаются в output
+        bool HandleCode()
         {
-            parse::Tokenazer_Base::HandleCode();
+            Token token;
+            MYTHON_LEXER_STAT(decltype(stats_->tokens) counts{});
+            while (Next(token))
+            {
+                MYTHON_LEXER_STAT(++counts[token.index()]);
+                output_.push_back(std::move(token));
+                if (locations_)
+                {
+                    locations_->Push(TokenLocation());
+                }
+            }
+            // Токены строки с ошибкой отбрасываются, поэтому учитываются только после разбора всей строки
+            MYTHON_LEXER_STAT(if (stats_ && !Error()) stats_->AddTokens(counts));
+            return !Error();
         }
 
     private:
         T &output_;
+        TokenLocations *locations_;
     }; // end of class Tokenazer
     //================================Tokenazer=====================================
 
-    Lexer::Lexer(std::istream &input)
+    namespace
     {
-        std::string buff;
-        while (std::getline(input, buff))
+        // Выполняет task(i) для i из [0, count) на пуле из threads потоков (0 - по числу ядер).
+        // Текущий поток тоже участвует в работе. Если задачи выбросили исключения, после завершения
+        // всех потоков выбрасывается исключение задачи с наименьшим номером, как при
+        // последовательном выполнении; задачи с большими номерами при этом не запускаются
+        template <typename Task>
+        void ParallelFor(size_t count, size_t threads, Task task)
         {
-            if (buff.empty())
-                continue;
+            // Номера выдаются по возрастанию, поэтому к моменту ошибки задачи i все задачи
+            // с меньшими номерами уже взяты в работу и будут доведены до конца
+            std::atomic<size_t> next = 0;
+            std::atomic<size_t> first_failed = count;
+            std::vector<std::exception_ptr> errors(count);
+            auto worker = [&]
+            {
+                for (size_t i = next++; i < first_failed.load(); i = next++)
+                {
+                    try
+                    {
+                        task(i);
+                    }
+                    catch (...)
+                    {
+                        errors[i] = std::current_exception();
+                        size_t failed = first_failed.load();
+                        while (i < failed && !first_failed.compare_exchange_weak(failed, i))
+                        {
+                        }
+                    }
+                }
+            };
+
+            if (threads == 0)
+            {
+                threads = std::max(1u, std::thread::hardware_concurrency());
+            }
+            threads = std::min(threads, count);
+
+            std::vector<std::thread> pool;
+            pool.reserve(threads);
+            for (size_t i = 1; i < threads; ++i)
+            {
+                pool.emplace_back(worker);
+            }
+            worker();
+            for (auto &thread : pool)
+            {
+                thread.join();
+            }
+            if (first_failed < count)
+            {
+                std::rethrow_exception(errors[first_failed]);
+            }
+        }
+
+        // Таблица symbols или новая, если она не задана
+        std::shared_ptr<symbols::SymbolTable> OrNewSymbolTable(std::shared_ptr<symbols::SymbolTable> symbols)
+        {
+            return symbols ? std::move(symbols) : std::make_shared<symbols::SymbolTable>();
+        }
+
+        // Строка меняет уровень отступа, если она не комментарий и не состоит из одних отступов
+        bool SetsIndentLevel(std::string_view line)
+        {
+            return line[0] != '#' && scan::IndentLength(line) != line.size();
+        }
+
+        // Токены фрагмента исходного текста, разобранного независимо от соседей
+        struct LexedChunk
+        {
+            std::vector<Token> tokens;
+            StringArena arena;
+            // Уровни отступа первой и последней строк, меняющих отступ
+            bool sets_level = false;
+            uint32_t first_level = 0;
+            uint32_t last_level = 0;
+            // Индекс первого токена первой такой строки: перед ним вставляются Indent/Dedent шва
+            size_t seam = 0;
+            // Позиция шва - первый символ этой строки после отступа. Строка может не дать
+            // ни одного токена (комментарий с отступом), поэтому позицию нельзя взять у токена seam
+            SourceLocation seam_location;
+            TokenLocations locations;
+            std::vector<LexerDiagnostic> errors;
+            LexerStats stats;
+        };
+
+        // first_line - номер первой строки фрагмента в файле. Имена интернируются в symbols
+        // через собственный кэш фрагмента
+        void LexChunk(std::string_view text, size_t first_line, bool zero_copy, ErrorPolicy errors,
+                      symbols::SymbolTable &symbols, LexedChunk &chunk)
+        {
+            MYTHON_LEXER_STAT(PhaseTimer timer(chunk.stats.tokenize_time));
+            symbols::SymbolCache symbol_cache(symbols);
+            uint32_t level = 0;
+            for (size_t line_number = first_line; !text.empty(); ++line_number)
+            {
+                auto end_pos = text.find('\n');
+                auto line = text.substr(0, end_pos);
+                text.remove_prefix(end_pos == std::string_view::npos ? text.size() : end_pos + 1);
+                MYTHON_LEXER_STAT(++chunk.stats.lines; chunk.stats.bytes += line.size() + 1);
+                if (line.empty())
+                    continue;
+
+                const bool had_level = chunk.sets_level;
+                const uint32_t saved_level = level;
+                const size_t saved_size = chunk.tokens.size();
+                if (!chunk.sets_level && SetsIndentLevel(line))
+                {
+                    // Разбираем фрагмент так, будто предыдущая строка имела тот же отступ
+                    chunk.sets_level = true;
+                    const size_t indent = scan::IndentLength(line);
+                    chunk.first_level = level = indent / 2;
+                    chunk.seam = chunk.tokens.size();
+                    chunk.seam_location = {static_cast<uint32_t>(line_number), static_cast<uint32_t>(indent + 1)};
+                }
 
-            Tokenazer tokinazer(buff, tokens_);
-            tokinazer.HandleCode();
+                Tokenazer tokinazer(line, chunk.tokens, level, line_number, symbol_cache,
+                                    zero_copy ? &chunk.arena : nullptr, &chunk.stats, &chunk.locations);
+                if (!tokinazer.HandleCode())
+                {
+                    if (errors == ErrorPolicy::Throw)
+                    {
+                        throw LexerError(*tokinazer.Error());
+                    }
+                    // Ошибочная строка пропускается, как будто её нет
+                    chunk.errors.push_back(*tokinazer.Error());
+                    chunk.tokens.resize(saved_size);
+                    chunk.locations.Truncate(saved_size);
+                    chunk.sets_level = had_level;
+                    level = saved_level;
+                }
+            }
+            chunk.last_level = level;
         }
+    } // namespace
 
-        tokens_.resize(
-            tokens_.size() + Tokenazer_Base::GetIndentLevel(),
-            Token{token_type::Dedent{}});
-        Tokenazer_Base::EraseIndent();
+    void StringArena::Merge(StringArena &&other)
+    {
+        // Текущий блок остаётся последним, чтобы в него можно было продолжать выделять
+        auto insert_pos = chunks_.empty() ? chunks_.end() : std::prev(chunks_.end());
+        chunks_.insert(insert_pos,
+                       std::make_move_iterator(other.chunks_.begin()),
+                       std::make_move_iterator(other.chunks_.end()));
+        other.chunks_.clear();
+        other.used_ = other.capacity_ = 0;
+    }
 
-        tokens_.emplace_back(token_type::Eof{});
-        current_token_ = tokens_.begin();
+    void TokenBuffer::AddBlock()
+    {
+        if (spare_blocks_.empty())
+        {
+            blocks_.emplace_back().reserve(BLOCK_SIZE);
+            return;
+        }
+        blocks_.push_back(std::move(spare_blocks_.back()));
+        spare_blocks_.pop_back();
     }
 
-    const Token &Lexer::CurrentToken() const
+    void TokenBuffer::Truncate(size_t size)
+    {
+        for (; size_ > size; --size_)
+        {
+            blocks_.back().pop_back();
+            if (blocks_.back().empty())
+            {
+                spare_blocks_.push_back(std::move(blocks_.back()));
+                blocks_.pop_back();
+            }
+        }
+    }
+
+    void TokenBuffer::PopFront(size_t count)
     {
-        return *current_token_;
+        released_ += count;
+        size_ -= count;
+        // Блок уходит в запас, только когда освобождены все его токены
+        size_t full_blocks = released_ / BLOCK_SIZE;
+        if (size_ == 0)
+        {
+            full_blocks = blocks_.size();
+        }
+        for (size_t i = 0; i < full_blocks; ++i)
+        {
+            blocks_[i].clear();
+            spare_blocks_.push_back(std::move(blocks_[i]));
+        }
+        blocks_.erase(blocks_.begin(), blocks_.begin() + static_cast<std::ptrdiff_t>(full_blocks));
+        released_ = size_ == 0 ? 0 : released_ - full_blocks * BLOCK_SIZE;
     }
 
-    Token Lexer::NextToken()
+    MappedFile::MappedFile(int fd, size_t size)
     {
-        if (current_token_ != (--tokens_.end()))
+        using namespace std::literals;
+
+        if (size == 0)
         {
-            ++current_token_;
+            return;
+        }
+
+        void *data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED)
+        {
+            throw LexerError("Cannot map file into memory"s);
         }
+        ::madvise(data, size, MADV_SEQUENTIAL);
+
+        data_ = static_cast<const char *>(data);
+        size_ = size;
+    }
 
-        return *current_token_;
+    LineReader::LineReader(std::istream &input, bool lazy)
+        : input_(&input), lazy_(lazy), block_(BLOCK_SIZE)
+    {
+    }
+
+    bool LineReader::Next(std::string_view &line)
+    {
+        size_t scanned = begin_;
+        for (;;)
+        {
+            const char *data = block_.data();
+            if (auto newline = static_cast<const char *>(std::memchr(data + scanned, '\n', end_ - scanned)))
+            {
+                const size_t end = newline - data;
+                line = std::string_view(data + begin_, end - begin_);
+                begin_ = end + 1;
+                return true;
+            }
+            scanned = end_ - begin_;
+
+            if (!Fill())
+            {
+                // Последняя строка без завершающего '\n'
+                if (begin_ == end_)
+                {
+                    return false;
+                }
+                line = std::string_view(block_.data() + begin_, end_ - begin_);
+                begin_ = end_;
+                return true;
+            }
+        }
+    }
+
+    bool LineReader::Fill()
+    {
+        // Начало недочитанной строки переносим в начало блока, длинную строку - в увеличенный блок
+        if (begin_ > 0)
+        {
+            std::copy(block_.begin() + begin_, block_.begin() + end_, block_.begin());
+            end_ -= begin_;
+            begin_ = 0;
+        }
+        if (end_ == block_.size())
+        {
+            block_.resize(block_.size() * 2);
+        }
+
+        auto *buf = input_->rdbuf();
+        std::streamsize size = static_cast<std::streamsize>(block_.size() - end_);
+        if (lazy_)
+        {
+            size = std::clamp<std::streamsize>(buf->in_avail(), 1, size);
+        }
+        const std::streamsize read = buf ? buf->sgetn(block_.data() + end_, size) : 0;
+        if (read <= 0)
+        {
+            input_->setstate(std::ios_base::eofbit);
+            return false;
+        }
+        end_ += static_cast<size_t>(read);
+        return true;
+    }
+
+    void LineReader::ReadAll(std::istream &input, std::vector<char> &out)
+    {
+        auto *buf = input.rdbuf();
+        size_t size = out.size();
+        while (buf)
+        {
+            out.resize(size + BLOCK_SIZE);
+            const std::streamsize read = buf->sgetn(out.data() + size, BLOCK_SIZE);
+            if (read <= 0)
+            {
+                break;
+            }
+            size += static_cast<size_t>(read);
+        }
+        out.resize(size);
+        input.setstate(std::ios_base::eofbit);
+    }
+
+    MappedFile MappedFile::Open(const std::filesystem::path &path)
+    {
+        using namespace std::literals;
+
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            throw LexerError("Cannot open file "s + path.string());
+        }
+
+        // Размер берётся у открытого дескриптора: файл по пути path могли уже заменить
+        struct stat info{};
+        if (::fstat(fd, &info) != 0 || !S_ISREG(info.st_mode))
+        {
+            ::close(fd);
+            throw LexerError("Cannot read file "s + path.string());
+        }
+
+        MappedFile result;
+        try
+        {
+            result = MappedFile(fd, static_cast<size_t>(info.st_size));
+        }
+        catch (...)
+        {
+            ::close(fd);
+            throw;
+        }
+        ::close(fd);
+        return result;
+    }
+
+    MappedFile::MappedFile(MappedFile &&other) noexcept
+        : data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0))
+    {
+    }
+
+    MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+    {
+        MappedFile released(std::move(other));
+        std::swap(data_, released.data_);
+        std::swap(size_, released.size_);
+        return *this;
+    }
+
+    MappedFile::~MappedFile()
+    {
+        if (data_)
+        {
+            ::munmap(const_cast<char *>(data_), size_);
+        }
+    }
+
+    Lexer::Lexer(std::istream &input, LexerMode mode, ErrorPolicy errors,
+                 std::shared_ptr<symbols::SymbolTable> symbols)
+        : mode_(mode), error_policy_(errors), symbols_(OrNewSymbolTable(std::move(symbols))),
+          symbol_cache_(*symbols_)
+    {
+        if (mode_ == LexerMode::ZeroCopy)
+        {
+            // Токены будут ссылаться на текст, поэтому он должен пережить разбор
+            MYTHON_LEXER_STAT(PhaseTimer timer(stats_.load_time));
+            LineReader::ReadAll(input, source_buffer_);
+            source_ = std::string_view(source_buffer_.data(), source_buffer_.size());
+        }
+        else
+        {
+            reader_ = LineReader(input, mode_ == LexerMode::Streaming);
+        }
+        LoadTokens();
+    }
+
+    Lexer::Lexer(const std::filesystem::path &path, LexerMode mode, size_t threads, ErrorPolicy errors,
+                 std::shared_ptr<symbols::SymbolTable> symbols)
+        : mode_(mode), error_policy_(errors), symbols_(OrNewSymbolTable(std::move(symbols))),
+          symbol_cache_(*symbols_)
+    {
+        const bool parallel = threads != 1 && mode_ != LexerMode::Streaming;
+        OpenFile(path, mode_ == LexerMode::ZeroCopy || parallel);
+
+        if (parallel)
+        {
+            TokenizeParallel(threads);
+        }
+        else
+        {
+            LoadTokens();
+        }
+    }
+
+    Lexer::Lexer(const std::filesystem::path &path, const std::filesystem::path &cache, LexerMode mode,
+                 std::shared_ptr<symbols::SymbolTable> symbols)
+        : mode_(mode == LexerMode::Streaming ? LexerMode::Eager : mode),
+          symbols_(OrNewSymbolTable(std::move(symbols))), symbol_cache_(*symbols_)
+    {
+        OpenFile(path, true);
+        uint64_t hash = 0;
+        std::optional<TokenStream> stream;
+        {
+            MYTHON_LEXER_STAT(PhaseTimer timer(stats_.load_time));
+            hash = HashSource(source_);
+            stream = TokenStream::Load(cache, hash, symbols_);
+        }
+
+        if (stream)
+        {
+            // В режиме ZeroCopy строки токенов ссылаются на пул кэша, поэтому кэш живёт вместе
+            // с лексером. В режиме Eager строки копируются, как при разборе
+            for (auto token : *stream)
+            {
+                if (auto *str = std::get_if<token_type::String>(&token); str && mode_ != LexerMode::ZeroCopy)
+                {
+                    str->value = TokenText(std::string(str->value.View()));
+                }
+                PushSyntheticToken(std::move(token));
+            }
+            if (mode_ == LexerMode::ZeroCopy)
+            {
+                cache_ = std::make_shared<const TokenStream>(std::move(*stream));
+            }
+            source_ = {};
+            mapping_ = MappedFile();
+            source_buffer_ = {};
+            eof_ = true;
+            return;
+        }
+
+        LoadTokens();
+
+        TokenStream fresh(symbols_);
+        for (size_t i = 0; i < tokens_.size(); ++i)
+        {
+            fresh.PushBack(tokens_[i]);
+        }
+        // Кэш только ускоряет следующий запуск, поэтому ошибка записи не мешает разбору
+        fresh.Save(cache, hash);
+    }
+
+    void Lexer::OpenFile(const std::filesystem::path &path, bool whole_source)
+    {
+        MYTHON_LEXER_STAT(PhaseTimer timer(stats_.load_time));
+        using namespace std::literals;
+
+        if (std::filesystem::is_regular_file(path))
+        {
+            mapping_ = MappedFile::Open(path);
+            source_ = mapping_.View();
+            return;
+        }
+
+        // Канал или устройство нельзя отобразить в память, читаем буферизованно
+        file_ = std::make_unique<std::ifstream>(path);
+        if (!*file_)
+        {
+            throw LexerError("Cannot open file "s + path.string());
+        }
+        if (whole_source)
+        {
+            LineReader::ReadAll(*file_, source_buffer_);
+            source_ = std::string_view(source_buffer_.data(), source_buffer_.size());
+        }
+        else
+        {
+            reader_ = LineReader(*file_, mode_ == LexerMode::Streaming);
+        }
+    }
+
+    void Lexer::TokenizeParallel(size_t threads)
+    {
+        // Время разбора фрагментов суммируется по потокам в stats_.tokenize_time
+        constexpr size_t MIN_CHUNK_SIZE = 256 * 1024;
+
+        if (threads == 0)
+        {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        // Режем по границам строк на несколько фрагментов на поток, чтобы выровнять нагрузку
+        const size_t chunk_count = std::clamp<size_t>(source_.size() / MIN_CHUNK_SIZE, 1, threads * 4);
+        std::vector<std::string_view> texts;
+        texts.reserve(chunk_count);
+        for (size_t begin = 0; begin < source_.size();)
+        {
+            size_t end = std::max(begin + 1, source_.size() * (texts.size() + 1) / chunk_count);
+            end = end < source_.size() ? source_.find('\n', end - 1) : source_.size();
+            end = end == std::string_view::npos ? source_.size() : end + 1;
+            texts.push_back(source_.substr(begin, end - begin));
+            begin = end;
+        }
+        source_ = {};
+
+        std::vector<size_t> first_lines(texts.size(), line_number_ + 1);
+        for (size_t i = 1; i < texts.size(); ++i)
+        {
+            first_lines[i] = first_lines[i - 1] + std::count(texts[i - 1].begin(), texts[i - 1].end(), '\n');
+        }
+
+        const bool zero_copy = mode_ == LexerMode::ZeroCopy;
+        std::vector<LexedChunk> chunks(texts.size());
+        ParallelFor(texts.size(), threads, [&](size_t i)
+                    { LexChunk(texts[i], first_lines[i], zero_copy, error_policy_, *symbols_, chunks[i]); });
+
+        // Склейка: на каждом шве восстанавливаем Indent/Dedent по уровням соседних фрагментов
+        for (auto &chunk : chunks)
+        {
+            for (size_t i = 0; i < chunk.seam; ++i)
+            {
+                tokens_.push_back(std::move(chunk.tokens[i]));
+            }
+            locations_.Append(chunk.locations, 0, chunk.seam);
+            if (chunk.sets_level)
+            {
+                // Токены шва относятся к началу строки после отступа, как и при последовательном разборе
+                for (; indent_level_ < chunk.first_level; ++indent_level_)
+                {
+                    PushSyntheticToken(token_type::Indent{});
+                    locations_.Push(chunk.seam_location);
+                }
+                for (; indent_level_ > chunk.first_level; --indent_level_)
+                {
+                    PushSyntheticToken(token_type::Dedent{});
+                    locations_.Push(chunk.seam_location);
+                }
+                indent_level_ = chunk.last_level;
+            }
+            for (size_t i = chunk.seam; i < chunk.tokens.size(); ++i)
+            {
+                tokens_.push_back(std::move(chunk.tokens[i]));
+            }
+            locations_.Append(chunk.locations, chunk.seam, chunk.locations.Size());
+            unescaped_.Merge(std::move(chunk.arena));
+            errors_.insert(errors_.end(), chunk.errors.begin(), chunk.errors.end());
+            MYTHON_LEXER_STAT(stats_.Merge(chunk.stats));
+        }
+
+        if (!texts.empty())
+        {
+            const auto last = texts.back();
+            line_number_ = first_lines.back() - 1 + std::count(last.begin(), last.end(), '\n') + (last.back() != '\n');
+        }
+        FinishTokens();
+    }
+
+    void Lexer::LoadTokens()
+    {
+        if (mode_ == LexerMode::Streaming)
+        {
+            while (tokens_.empty() && !eof_)
+            {
+                ReadLine();
+            }
+        }
+        else
+        {
+            while (!eof_)
+            {
+                ReadLine();
+            }
+        }
+    }
+
+    bool Lexer::NextLine(std::string_view &line)
+    {
+        if (reader_.IsOpen())
+        {
+            if (!reader_.Next(line))
+            {
+                return false;
+            }
+            ++line_number_;
+            MYTHON_LEXER_STAT(++stats_.lines; stats_.bytes += line.size() + 1);
+            return true;
+        }
+
+        if (source_.empty())
+        {
+            return false;
+        }
+        ++line_number_;
+
+        auto end_pos = source_.find('\n');
+        line = source_.substr(0, end_pos);
+        source_.remove_prefix(end_pos == std::string_view::npos ? source_.size() : end_pos + 1);
+        MYTHON_LEXER_STAT(++stats_.lines; stats_.bytes += line.size() + 1);
+        return true;
+    }
+
+    bool Lexer::TokenizeLine(std::string_view line)
+    {
+        const uint32_t saved_level = indent_level_;
+        const size_t saved_size = tokens_.size();
+        const size_t saved_locations = locations_.Size();
+        Tokenazer tokinazer(line, tokens_, indent_level_, line_number_, symbol_cache_,
+                            mode_ == LexerMode::ZeroCopy ? &unescaped_ : nullptr, &stats_, &locations_);
+        if (tokinazer.HandleCode())
+        {
+            return true;
+        }
+
+        if (error_policy_ == ErrorPolicy::Throw)
+        {
+            throw LexerError(*tokinazer.Error());
+        }
+        errors_.push_back(*tokinazer.Error());
+        tokens_.Truncate(saved_size);
+        locations_.Truncate(saved_locations);
+        indent_level_ = saved_level;
+        return false;
+    }
+
+    void Lexer::ReadLine()
+    {
+        MYTHON_LEXER_STAT(PhaseTimer timer(stats_.tokenize_time));
+        std::string_view line;
+        while (NextLine(line))
+        {
+            if (line.empty())
+                continue;
+
+            if (TokenizeLine(line))
+            {
+                return;
+            }
+        }
+
+        FinishTokens();
+    }
+
+    void Lexer::PushSyntheticToken(Token token)
+    {
+        MYTHON_LEXER_STAT(++stats_.tokens[token.index()]);
+        tokens_.push_back(std::move(token));
+    }
+
+    void Lexer::FinishTokens()
+    {
+        // Закрывающие токены относятся к началу строки за последней
+        const SourceLocation end{static_cast<uint32_t>(line_number_ + 1), 1};
+        for (uint32_t i = 0; i <= indent_level_; ++i)
+        {
+            locations_.Push(end);
+        }
+        for (; indent_level_ > 0; --indent_level_)
+        {
+            PushSyntheticToken(token_type::Dedent{});
+        }
+
+        PushSyntheticToken(token_type::Eof{});
+        eof_ = true;
+        reader_ = LineReader();
+        file_.reset();
+        if (mode_ != LexerMode::ZeroCopy)
+        {
+            mapping_ = MappedFile{};
+        }
+    }
+
+    Generator<Token> Lexer::Generate(std::istream &input, std::shared_ptr<symbols::SymbolTable> symbols)
+    {
+        symbols = OrNewSymbolTable(std::move(symbols));
+        symbols::SymbolCache symbol_cache(*symbols);
+        LineReader reader(input, true);
+        uint32_t level = 0;
+        size_t line_number = 0;
+        std::string_view line;
+        Token token;
+        while (reader.Next(line))
+        {
+            ++line_number;
+            if (line.empty())
+                continue;
+
+            Tokenazer_Base tokenazer(line, level, line_number, symbol_cache);
+            while (tokenazer.Next(token))
+            {
+                co_yield token;
+            }
+            if (tokenazer.Error())
+            {
+                throw LexerError(*tokenazer.Error());
+            }
+        }
+
+        for (; level > 0; --level)
+        {
+            co_yield Token{token_type::Dedent{}};
+        }
+        co_yield Token{token_type::Eof{}};
+    }
+
+    bool Lexer::FetchTokens(size_t count)
+    {
+        if (current_token_ + count >= tokens_.size() && !eof_ && mode_ == LexerMode::Streaming)
+        {
+            ReleaseTokens();
+        }
+
+        while (current_token_ + count >= tokens_.size() && !eof_)
+        {
+            ReadLine();
+        }
+        return current_token_ + count < tokens_.size();
+    }
+
+    void Lexer::ReleaseTokens()
+    {
+        size_t keep_from = CurrentIndex();
+        if (!marks_.empty())
+        {
+            keep_from = std::min(keep_from, *std::min_element(marks_.begin(), marks_.end()));
+        }
+        // Последние RETAINED_TOKENS пройденных токенов остаются на месте вместе со ссылками на них
+        if (keep_from < released_tokens_ + 2 * RETAINED_TOKENS)
+        {
+            return;
+        }
+        const size_t count = keep_from - RETAINED_TOKENS - released_tokens_;
+        tokens_.PopFront(count);
+        released_tokens_ += count;
+        current_token_ -= count;
+        locations_.Release(released_tokens_);
+    }
+
+    size_t Lexer::Mark()
+    {
+        marks_.push_back(CurrentIndex());
+        return marks_.back();
+    }
+
+    void Lexer::Rewind(size_t mark)
+    {
+        using namespace std::literals;
+
+        if (mark < released_tokens_ || mark - released_tokens_ >= tokens_.size())
+        {
+            throw std::out_of_range("Token "s + std::to_string(mark) + " is not buffered"s);
+        }
+        current_token_ = mark - released_tokens_;
+    }
+
+    void Lexer::Commit(size_t mark)
+    {
+        // Снимается последняя поставленная такая метка: обычно метки снимаются в обратном порядке
+        auto it = std::find(marks_.rbegin(), marks_.rend(), mark);
+        if (it != marks_.rend())
+        {
+            marks_.erase(std::next(it).base());
+        }
+    }
+
+    const Token *Lexer::PeekNext()
+    {
+        return FetchTokens(1) ? &tokens_[current_token_ + 1] : nullptr;
+    }
+
+    const Token &Lexer::PeekToken(size_t n)
+    {
+        using namespace std::literals;
+
+        if (n > MAX_LOOKAHEAD)
+        {
+            throw std::out_of_range("Lookahead is limited to "s + std::to_string(MAX_LOOKAHEAD) + " tokens"s);
+        }
+        // Последний токен потока - Eof
+        return FetchTokens(n) ? tokens_[current_token_ + n] : tokens_.back();
+    }
+
+    const Token &Lexer::CurrentToken() const
+    {
+        return tokens_[current_token_];
+    }
+
+    Token Lexer::NextToken()
+    {
+        if (PeekNext())
+        {
+            ++current_token_;
+        }
+
+        return tokens_[current_token_];
+    }
+
+    std::optional<SourceLocation> Lexer::Location(size_t index) const
+    {
+        if (index < locations_.Released() || index >= locations_.Size())
+        {
+            return std::nullopt;
+        }
+        return locations_[index];
+    }
+
+    LexerDiagnostic Lexer::Diagnostic(std::string message, size_t index) const
+    {
+        const auto location = Location(index).value_or(SourceLocation{});
+        return LexerDiagnostic{std::move(message), location.line, location.column};
+    }
+
+    std::vector<LexedFile> LexFiles(const std::vector<std::filesystem::path> &paths, LexerMode mode, size_t threads)
+    {
+        std::vector<LexedFile> result(paths.size());
+        ParallelFor(paths.size(), threads, [&](size_t i)
+                    {
+                        try
+                        {
+                            result[i].lexer.emplace(paths[i], mode);
+                        }
+                        catch (...)
+                        {
+                            result[i].error = std::current_exception();
+                        } });
+
+        return result;
+    }
+
+    IncrementalLexer::IncrementalLexer(std::string_view text, std::shared_ptr<symbols::SymbolTable> symbols)
+        : symbols_(OrNewSymbolTable(std::move(symbols))), symbol_cache_(*symbols_), lines_(LexLines(text, 1))
+    {
+        gap_begin_ = lines_.size();
+        last_relexed_ = lines_.size();
+    }
+
+    void IncrementalLexer::Edit(size_t first_line, size_t last_line, std::string_view text)
+    {
+        using namespace std::literals;
+
+        if (first_line > last_line || last_line > LineCount())
+        {
+            throw std::out_of_range("Invalid line range"s);
+        }
+
+        // Разбор до изменения lines_, чтобы ошибка не портила текст
+        auto replacement = LexLines(text, first_line + 1);
+        last_relexed_ = replacement.size();
+
+        // Заменяемые строки оказываются сразу перед разрывом и присоединяются к нему
+        MoveGap(last_line);
+        for (size_t i = first_line; i < last_line; ++i)
+        {
+            lines_[i] = SourceLine();
+        }
+        gap_size_ += last_line - first_line;
+        gap_begin_ = first_line;
+
+        GrowGap(replacement.size());
+        std::move(replacement.begin(), replacement.end(), lines_.begin() + gap_begin_);
+        gap_begin_ += replacement.size();
+        gap_size_ -= replacement.size();
+    }
+
+    void IncrementalLexer::MoveGap(size_t line)
+    {
+        // При пустом разрыве строки сдвигались бы сами на себя
+        if (gap_size_ != 0)
+        {
+            const auto begin = lines_.begin();
+            if (line < gap_begin_)
+            {
+                std::move_backward(begin + line, begin + gap_begin_, begin + gap_begin_ + gap_size_);
+            }
+            else
+            {
+                std::move(begin + gap_begin_ + gap_size_, begin + line + gap_size_, begin + gap_begin_);
+            }
+        }
+        gap_begin_ = line;
+    }
+
+    void IncrementalLexer::GrowGap(size_t size)
+    {
+        if (gap_size_ >= size)
+        {
+            return;
+        }
+        // Разрыв растёт с запасом в половину файла, чтобы расширения случались редко
+        const size_t new_gap = size + std::max<size_t>(64, LineCount() / 2);
+        std::vector<SourceLine> lines(LineCount() + new_gap);
+        const auto gap_end = lines_.begin() + gap_begin_ + gap_size_;
+        std::move(lines_.begin(), lines_.begin() + gap_begin_, lines.begin());
+        std::move(gap_end, lines_.end(), lines.begin() + gap_begin_ + new_gap);
+        lines_ = std::move(lines);
+        gap_size_ = new_gap;
+    }
+
+    IncrementalLexer::TokenRange IncrementalLexer::Tokens() const
+    {
+        return {TokenIterator(this, 0), TokenIterator(this, LineCount() + 1)};
+    }
+
+    const Token &IncrementalLexer::TokenIterator::operator*() const
+    {
+        static const Token indent{token_type::Indent{}};
+        static const Token dedent{token_type::Dedent{}};
+        static const Token eof{token_type::Eof{}};
+
+        if (line_ < lexer_->LineCount())
+        {
+            const auto &line = lexer_->At(line_);
+            if (line.level && *line.level != level_)
+            {
+                return *line.level > level_ ? indent : dedent;
+            }
+            return line.tokens[token_];
+        }
+        return level_ > 0 ? dedent : eof;
+    }
+
+    IncrementalLexer::TokenIterator &IncrementalLexer::TokenIterator::operator++()
+    {
+        if (line_ < lexer_->LineCount())
+        {
+            const auto &line = lexer_->At(line_);
+            if (line.level && *line.level != level_)
+            {
+                *line.level > level_ ? ++level_ : --level_;
+            }
+            else
+            {
+                ++token_;
+            }
+            SkipEmptyLines();
+        }
+        else if (level_ > 0)
+        {
+            --level_;
+        }
+        else
+        {
+            ++line_;
+        }
+        return *this;
+    }
+
+    void IncrementalLexer::TokenIterator::SkipEmptyLines()
+    {
+        for (; line_ < lexer_->LineCount(); ++line_, token_ = 0)
+        {
+            const auto &line = lexer_->At(line_);
+            if ((line.level && *line.level != level_) || token_ < line.tokens.size())
+            {
+                return;
+            }
+        }
+    }
+
+    std::vector<IncrementalLexer::SourceLine> IncrementalLexer::LexLines(std::string_view text, size_t first_line)
+    {
+        std::vector<SourceLine> result;
+        for (size_t line_number = first_line; !text.empty(); ++line_number)
+        {
+            auto end_pos = text.find('\n');
+            auto &line = result.emplace_back();
+            line.text = text.substr(0, end_pos);
+            text.remove_prefix(end_pos == std::string_view::npos ? text.size() : end_pos + 1);
+            if (line.text.empty())
+                continue;
+
+            // Строка разбирается на собственном уровне, поэтому Tokenazer не выдаёт Indent/Dedent
+            uint32_t level = 0;
+            if (SetsIndentLevel(line.text))
+            {
+                line.level = level = scan::IndentLength(line.text) / 2;
+            }
+            Tokenazer tokinazer(line.text, line.tokens, level, line_number, symbol_cache_);
+            if (!tokinazer.HandleCode())
+            {
+                throw LexerError(*tokinazer.Error());
+            }
+        }
+        return result;
     }
 } // namespace parse
\ No newline at end of file
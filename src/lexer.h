@@ -1,16 +1,103 @@
 #pragma once
 
+#include "generator.h"
+#include "symbol_table.h"
+#include "token_locations.h"
+
+#include <array>
+#include <chrono>
 #include <iosfwd>
+#include <ostream>
 #include <optional>
+#include <ranges>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <iterator>
+#include <memory>
+#include <string_view>
 #include <variant>
-#include <list>
+#include <vector>
 
 namespace parse
 {
 
+    // Текст строковой лексемы.
+    // Либо владеет строкой, либо ссылается на буфер, который держит живым Lexer (LexerMode::ZeroCopy)
+    class TokenText
+    {
+    public:
+        explicit TokenText(std::string value) : value_(std::move(value)) {}
+        // Не владеющий текст: view должен жить дольше токена
+        explicit TokenText(std::string_view view) : value_(view) {}
+
+        [[nodiscard]] std::string_view View() const
+        {
+            return std::visit([](const auto &value)
+                              { return std::string_view(value); }, value_);
+        }
+
+        operator std::string_view() const // NOLINT(google-explicit-constructor)
+        {
+            return View();
+        }
+
+        // Копия текста: value можно присвоить std::string, как до появления режима ZeroCopy
+        operator std::string() const // NOLINT(google-explicit-constructor)
+        {
+            return std::string(View());
+        }
+
+        // Возвращает true, если текст ссылается на чужой буфер
+        [[nodiscard]] bool IsView() const
+        {
+            return std::holds_alternative<std::string_view>(value_);
+        }
+
+        friend bool operator==(const TokenText &lhs, const TokenText &rhs)
+        {
+            return lhs.View() == rhs.View();
+        }
+
+        friend bool operator==(const TokenText &lhs, std::string_view rhs)
+        {
+            return lhs.View() == rhs;
+        }
+
+        friend std::ostream &operator<<(std::ostream &os, const TokenText &text)
+        {
+            return os << text.View();
+        }
+
+    private:
+        std::variant<std::string, std::string_view> value_;
+    };
+
+    // Буфер для строк, раскодированных из escape-последовательностей в режиме ZeroCopy.
+    // Память выделяется крупными блоками и не перемещается до разрушения арены
+    class StringArena
+    {
+    public:
+        // Возвращает указатель на size свободных символов
+        char *Allocate(size_t size);
+        // Возвращает указатель на size свободных символов, не занимая их. Занять можно
+        // меньше, вызвав Commit до следующего обращения к арене
+        char *Reserve(size_t size);
+        void Commit(size_t size);
+        // Забирает блоки other; строки в них остаются на прежних адресах
+        void Merge(StringArena &&other);
+
+    private:
+        static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+        std::vector<std::unique_ptr<char[]>> chunks_;
+        size_t used_ = 0;
+        size_t capacity_ = 0;
+    };
+
     namespace token_type
     {
         struct Number
@@ -18,12 +105,25 @@ namespace parse
             int value; // число
         };
 
+        struct BigNumber
+        {                  // Лексема «число», не помещающееся в int
+            int64_t value; // число
+        };
+
         struct Id
         { // Лексема «идентификатор»
             Id(const std::string &v) : value(v) {}
             Id(std::string &&v) : value(std::move(v)) {}
-
-            std::string value; // Имя идентификатора
+            // Имя из таблицы символов: токен ссылается на строку таблицы, не копируя её
+            Id(symbols::Symbol s) : value(s.name), symbol(s.id) {}
+
+            // Имя идентификатора. У токенов лексера и TokenStream ссылается на строку таблицы
+            // символов (Lexer::Symbols, TokenStream::Symbols) и живёт, пока жива таблица.
+            // Приводится к std::string
+            TokenText value;
+            // Номер имени в таблице символов лексера (см. Lexer::Symbols).
+            // У идентификаторов, созданных не лексером, - symbols::NO_SYMBOL
+            symbols::SymbolId symbol = symbols::NO_SYMBOL;
         };
 
         struct Char
@@ -35,8 +135,11 @@ namespace parse
         { // Лексема «строковая константа»
             String(const std::string &v) : value(v) {}
             String(std::string &&v) : value(std::move(v)) {}
+            String(TokenText v) : value(std::move(v)) {}
 
-            std::string value;
+            // Владеет строкой в режимах Eager и Streaming и ссылается на буфер лексера
+            // только в режиме ZeroCopy. Приводится к std::string
+            TokenText value;
         };
 
         struct Class
@@ -106,7 +209,8 @@ namespace parse
                                    token_type::Def, token_type::Newline, token_type::Print, token_type::Indent,
                                    token_type::Dedent, token_type::And, token_type::Or, token_type::Not,
                                    token_type::Eq, token_type::NotEq, token_type::LessOrEq, token_type::GreaterOrEq,
-                                   token_type::None, token_type::True, token_type::False, token_type::Eof>;
+                                   token_type::None, token_type::True, token_type::False, token_type::Eof,
+                                   token_type::BigNumber>;
 
     struct Token : TokenBase
     {
@@ -136,16 +240,316 @@ namespace parse
 
     std::ostream &operator<<(std::ostream &os, const Token &rhs);
 
+    // Последовательность токенов, хранимая блоками по BLOCK_SIZE. Токены не перемещаются
+    // ни при дописывании, ни при освобождении из начала. Освобождённые блоки используются
+    // повторно, так что потоковый разбор не выделяет память под токены
+    class TokenBuffer
+    {
+    public:
+        static constexpr size_t BLOCK_SIZE = 256;
+
+        [[nodiscard]] size_t size() const
+        {
+            return size_;
+        }
+
+        [[nodiscard]] bool empty() const
+        {
+            return size_ == 0;
+        }
+
+        [[nodiscard]] const Token &operator[](size_t index) const
+        {
+            index += released_;
+            return blocks_[index / BLOCK_SIZE][index % BLOCK_SIZE];
+        }
+
+        [[nodiscard]] const Token &back() const
+        {
+            return blocks_.back().back();
+        }
+
+        template <typename... Args>
+        void emplace_back(Args &&...args)
+        {
+            if (blocks_.empty() || blocks_.back().size() == BLOCK_SIZE)
+            {
+                AddBlock();
+            }
+            blocks_.back().emplace_back(std::forward<Args>(args)...);
+            ++size_;
+        }
+
+        void push_back(Token &&token)
+        {
+            emplace_back(std::move(token));
+        }
+
+        // Оставляет первые size токенов
+        void Truncate(size_t size);
+
+        // Освобождает первые count токенов. Память освобождается целыми блоками
+        void PopFront(size_t count);
+
+    private:
+        void AddBlock();
+
+        // Блок создаётся с ёмкостью BLOCK_SIZE и никогда её не превышает, поэтому
+        // его элементы не перемещаются, даже когда перемещается сам std::vector
+        std::vector<std::vector<Token>> blocks_;
+        std::vector<std::vector<Token>> spare_blocks_;
+        // Сколько токенов в начале первого блока уже освобождено
+        size_t released_ = 0;
+        size_t size_ = 0;
+    };
+
+    class TokenStream;
+
+    // Имя типа лексемы с номером kind в варианте Token, например "Newline"
+    const char *TokenKindName(size_t kind);
+
+    // Счётчики и время работы лексера. Собираются, только если проект собран
+    // с определённым MYTHON_LEXER_STATS (cmake -DMYTHON_LEXER_STATS=ON), иначе остаются нулями
+    // и не стоят ничего
+    struct LexerStats
+    {
+#ifdef MYTHON_LEXER_STATS
+        static constexpr bool ENABLED = true;
+#else
+        static constexpr bool ENABLED = false;
+#endif
+
+        using TokenCounts = std::array<uint64_t, std::variant_size_v<TokenBase>>;
+
+        // Число токенов по номеру типа в варианте Token, включая Indent, Dedent и Eof,
+        // которые дописывает Lexer, так что сумма совпадает с длиной последовательности токенов
+        TokenCounts tokens{};
+        uint64_t lines = 0;
+        // Размер прочитанных строк вместе с переводами строк
+        uint64_t bytes = 0;
+        // Строковые литералы с escape-последовательностями
+        uint64_t escape_decodes = 0;
+        // Слова, не оказавшиеся ключевыми (идентификаторы)
+        uint64_t keyword_misses = 0;
+        // Открытие и чтение источника целиком (mmap, чтение потока, загрузка кэша)
+        std::chrono::nanoseconds load_time{};
+        // Чтение и разбор строк
+        std::chrono::nanoseconds tokenize_time{};
+
+        [[nodiscard]] uint64_t TotalTokens() const;
+        void AddTokens(const TokenCounts &counts);
+        void Merge(const LexerStats &other);
+    };
+
+    std::ostream &operator<<(std::ostream &os, const LexerStats &stats);
+
+    // Описание ошибки разбора, передаваемое без исключения
+    struct LexerDiagnostic
+    {
+        std::string message;
+        // Позиция ошибки (с 1) или 0, если она неизвестна
+        size_t line = 0;
+        size_t column = 0;
+    };
+
     class LexerError : public std::runtime_error
     {
     public:
         using std::runtime_error::runtime_error;
+
+        // Ошибка в строке line и столбце column исходного текста (оба считаются с 1)
+        LexerError(const std::string &message, size_t line, size_t column);
+        explicit LexerError(const LexerDiagnostic &diagnostic);
+
+        // Позиция ошибки или 0, если она неизвестна
+        [[nodiscard]] size_t Line() const
+        {
+            return line_;
+        }
+
+        [[nodiscard]] size_t Column() const
+        {
+            return column_;
+        }
+
+    private:
+        size_t line_ = 0;
+        size_t column_ = 0;
+    };
+
+    // Результат TryExpect: ссылка на значение токена или описание ошибки.
+    // Повторяет интерфейс std::expected<const T &, LexerDiagnostic>
+    template <typename T>
+    class Expected
+    {
+    public:
+        Expected(const T &value) : value_(&value) {}
+        Expected(LexerDiagnostic error) : error_(std::move(error)) {}
+
+        [[nodiscard]] bool has_value() const
+        {
+            return value_ != nullptr;
+        }
+
+        explicit operator bool() const
+        {
+            return has_value();
+        }
+
+        const T &operator*() const
+        {
+            return *value_;
+        }
+
+        const T *operator->() const
+        {
+            return value_;
+        }
+
+        // Значение, а при ошибке - исключение LexerError
+        const T &value() const
+        {
+            if (!value_)
+            {
+                throw LexerError(error_);
+            }
+            return *value_;
+        }
+
+        [[nodiscard]] const LexerDiagnostic &error() const
+        {
+            return error_;
+        }
+
+    private:
+        const T *value_ = nullptr;
+        LexerDiagnostic error_;
+    };
+
+    // Реакция лексера на ошибки в исходном тексте
+    enum class ErrorPolicy
+    {
+        Throw,   // первая ошибка выбрасывается как LexerError
+        Collect, // ошибки копятся в Lexer::Errors(), ошибочная строка пропускается целиком
+    };
+
+    // Режим работы лексера
+    enum class LexerMode
+    {
+        Eager,     // весь поток разбирается в конструкторе
+        Streaming, // строки читаются из потока по мере запроса токенов
+        ZeroCopy,  // как Eager, но String ссылаются на исходный текст, который хранит лексер
+    };
+
+    // Файл, отображённый в память только для чтения
+    class MappedFile
+    {
+    public:
+        MappedFile() = default;
+        // Отображает size байт открытого файла fd. При ошибке выбрасывает LexerError
+        MappedFile(int fd, size_t size);
+        // Открывает и отображает файл path целиком. При ошибке выбрасывает LexerError
+        static MappedFile Open(const std::filesystem::path &path);
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+        MappedFile(MappedFile &&other) noexcept;
+        MappedFile &operator=(MappedFile &&other) noexcept;
+        ~MappedFile();
+
+        [[nodiscard]] std::string_view View() const
+        {
+            return {data_, size_};
+        }
+
+    private:
+        const char *data_ = nullptr;
+        size_t size_ = 0;
+    };
+
+    // Построчное чтение потока крупными блоками через rdbuf(), без std::getline и копирования строк
+    class LineReader
+    {
+    public:
+        LineReader() = default;
+        // При lazy из потока читается не больше, чем в нём уже буферизовано (но не меньше байта),
+        // чтобы не ждать данных, которые ещё не поступили, например с терминала
+        LineReader(std::istream &input, bool lazy);
+
+        // Выдаёт очередную строку без '\n'. Строка действительна до следующего вызова
+        bool Next(std::string_view &line);
+
+        [[nodiscard]] bool IsOpen() const
+        {
+            return input_ != nullptr;
+        }
+
+        // Дочитывает input до конца в out
+        static void ReadAll(std::istream &input, std::vector<char> &out);
+
+    private:
+        // Дочитывает блок за концом данных буфера. Возвращает false на конце потока
+        bool Fill();
+
+        static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+        std::istream *input_ = nullptr;
+        bool lazy_ = false;
+        std::vector<char> block_;
+        // Непрочитанные данные занимают [begin_, end_) в block_
+        size_t begin_ = 0;
+        size_t end_ = 0;
     };
 
     class Lexer
     {
     public:
-        explicit Lexer(std::istream &input);
+        // В режиме Streaming лексер хранит ссылку на input и читает его лениво,
+        // удерживая в памяти только текущий токен и остаток текущей строки.
+        // Поток должен жить, пока лексер не дойдёт до token_type::Eof.
+        // Имена Id интернируются в symbols; если она не задана, лексер заводит свою таблицу.
+        // Лексеры, разбирающие части одной программы, передают одну таблицу, чтобы номера совпадали
+        explicit Lexer(std::istream &input, LexerMode mode = LexerMode::Eager,
+                       ErrorPolicy errors = ErrorPolicy::Throw,
+                       std::shared_ptr<symbols::SymbolTable> symbols = nullptr);
+
+        // В режиме ZeroCopy текст String ссылается на буферы лексера:
+        // токены нельзя использовать после разрушения лексера.
+
+        // Разбирает файл path. Обычный файл отображается в память и разбирается на месте,
+        // без копирования строк; прочие (каналы, устройства) читаются через std::ifstream.
+        // При threads != 1 (0 - по числу ядер) файл режется по границам строк на фрагменты,
+        // которые разбираются параллельно; результат совпадает с последовательным разбором.
+        // В режиме Streaming threads не используется
+        explicit Lexer(const std::filesystem::path &path, LexerMode mode = LexerMode::Eager, size_t threads = 1,
+                       ErrorPolicy errors = ErrorPolicy::Throw,
+                       std::shared_ptr<symbols::SymbolTable> symbols = nullptr);
+
+        // Разбирает файл path, используя кэш токенов cache (см. TokenStream::Save).
+        // Если кэш записан для того же содержимого path, токены загружаются из него без разбора,
+        // иначе файл разбирается и кэш перезаписывается. Режим Streaming заменяется на Eager
+        Lexer(const std::filesystem::path &path, const std::filesystem::path &cache, LexerMode mode = LexerMode::Eager,
+              std::shared_ptr<symbols::SymbolTable> symbols = nullptr);
+
+        // Ленивый разбор потока: токены вычисляются по одному при продвижении итератора,
+        // без промежуточного контейнера. Последовательность та же, что у Lexer в режиме Eager,
+        // и заканчивается token_type::Eof. Поток input должен жить, пока генератор используется.
+        // Имена Id интернируются в symbols или, если она не задана, в собственную таблицу генератора.
+        // Id ссылаются на строки таблицы: чтобы хранить токены дольше генератора, передайте symbols
+        static Generator<Token> Generate(std::istream &input, std::shared_ptr<symbols::SymbolTable> symbols = nullptr);
+
+        // Таблица, в которой интернированы имена Id этого лексера
+        [[nodiscard]] const std::shared_ptr<symbols::SymbolTable> &Symbols() const
+        {
+            return symbols_;
+        }
+
+        // Ссылки, которые возвращают CurrentToken, PeekToken, Expect, ExpectNext и TryExpect*,
+        // указывают на токен в буфере лексера и не перемещаются, пока токен в нём хранится.
+        // В режимах Eager и ZeroCopy это всё время жизни лексера. В режиме Streaming токен
+        // освобождается не раньше, чем текущим станет токен на RETAINED_TOKENS дальше него
+        // (и самой ранней неснятой метки), так что ссылка переживает не меньше RETAINED_TOKENS
+        // вызовов NextToken
 
         // Возвращает ссылку на текущий токен или token_type::Eof, если поток токенов закончился
         [[nodiscard]] const Token &CurrentToken() const;
@@ -153,6 +557,71 @@ namespace parse
         // Возвращает следующий токен, либо token_type::Eof, если поток токенов закончился
         Token NextToken();
 
+        // Статистика разбора (см. LexerStats). В режиме Streaming пополняется по мере чтения
+        [[nodiscard]] const LexerStats &Stats() const
+        {
+            return stats_;
+        }
+
+        // Ошибки, накопленные в режиме ErrorPolicy::Collect, в порядке строк источника.
+        // В режиме Streaming пополняется по мере чтения
+        [[nodiscard]] const std::vector<LexerDiagnostic> &Errors() const
+        {
+            return errors_;
+        }
+
+        // Номер текущего токена от начала потока. В режиме Streaming учитываются и освобождённые токены
+        [[nodiscard]] size_t CurrentIndex() const
+        {
+            return released_tokens_ + current_token_;
+        }
+
+        // Позиция начала токена с номером index в источнике. Indent и Dedent относятся к первому
+        // символу строки после отступа, Newline - к концу строки, закрывающие Dedent и Eof -
+        // к началу строки за последней. Позиции хранятся отдельно от токенов (см. TokenLocations);
+        // в режиме Streaming они освобождаются вслед за токенами, но с запаздыванием.
+        // Возвращает std::nullopt, если токен ещё не прочитан, его позиция освобождена
+        // или токены загружены из кэша
+        [[nodiscard]] std::optional<SourceLocation> Location(size_t index) const;
+
+        [[nodiscard]] std::optional<SourceLocation> CurrentLocation() const
+        {
+            return Location(CurrentIndex());
+        }
+
+        // Сколько пройденных токенов режим Streaming держит в памяти позади текущего
+        // и позади самой ранней метки. Освобождаются они пачками не меньше этого размера
+        static constexpr size_t RETAINED_TOKENS = 32;
+
+        // Метка для возврата к текущему токену (см. Rewind). В режиме Streaming пройденные токены
+        // освобождаются, но не раньше самой ранней метки, которая ещё не снята Commit.
+        // Так разбор с возвратами обходится окном от самой ранней метки до текущего токена.
+        // Ссылки на токены от метки и дальше действительны, пока метка не снята
+        size_t Mark();
+        // Делает текущим токен, на котором поставлена метка mark. Метка остаётся в силе.
+        // Если mark - не поставленная метка и её токен уже освобождён, выбрасывает std::out_of_range.
+        // Токены не перечитываются, поэтому ссылки, полученные до возврата, указывают на те же токены
+        void Rewind(size_t mark);
+        // Снимает метку: возврата к ней больше не будет, и токены до неё можно освобождать.
+        // Ссылки на них остаются действительными на срок, описанный перед CurrentToken
+        void Commit(size_t mark);
+
+        // Сколько токенов сейчас хранится в памяти
+        [[nodiscard]] size_t BufferedTokens() const
+        {
+            return tokens_.size();
+        }
+
+        // Наибольшее n, допустимое в PeekToken
+        static constexpr size_t MAX_LOOKAHEAD = 16;
+
+        // Возвращает токен через n позиций после текущего, не сдвигая текущую позицию
+        // (PeekToken(0) - текущий токен). За концом потока возвращает token_type::Eof.
+        // В режиме Streaming дочитывает строки, лишь пока не наберётся n токенов, так что
+        // в памяти остаётся окно из текущей строки и не более MAX_LOOKAHEAD токенов вперёд.
+        // При n > MAX_LOOKAHEAD выбрасывает std::out_of_range
+        const Token &PeekToken(size_t n);
+
         // Если текущий токен имеет тип T, метод возвращает ссылку на него.
         // В противном случае метод выбрасывает исключение LexerError
         template <typename T>
@@ -191,15 +660,15 @@ namespace parse
         const T &ExpectNext()
         {
             using namespace std::literals;
-            auto it = std::next(current_token_);
+            auto next = PeekNext();
 
-            if (it == tokens_.end() || !it->Is<T>())
+            if (!next || !next->Is<T>())
             {
                 throw LexerError("Wrong token type"s);
             }
 
-            current_token_ = it;
-            return it->As<T>();
+            ++current_token_;
+            return next->As<T>();
         }
 
         // Метод проверяет, что следующий токен имеет тип T, а сам токен содержит значение value.
@@ -209,19 +678,298 @@ namespace parse
         {
             using namespace std::literals;
 
-            auto it = std::next(current_token_);
+            auto next = PeekNext();
 
-            if (it == tokens_.end() || !it->Is<T>() || it->As<T>().value != value)
+            if (!next || !next->Is<T>() || next->As<T>().value != value)
             {
                 throw LexerError("Wrong token type"s);
             }
 
-            current_token_ = it;
+            ++current_token_;
+        }
+
+        // Варианты Expect и ExpectNext, сообщающие об ошибке результатом, а не исключением.
+        // Ошибка содержит позицию проверяемого токена
+        template <typename T>
+        Expected<T> TryExpect() const
+        {
+            if (auto curr = CurrentToken().TryAs<T>())
+            {
+                return *curr;
+            }
+            return Diagnostic("Wrong token type", CurrentIndex());
+        }
+
+        template <typename T, typename U>
+        Expected<T> TryExpect(const U &value) const
+        {
+            auto curr = TryExpect<T>();
+            if (curr && curr->value != value)
+            {
+                return Diagnostic("Wrong token value", CurrentIndex());
+            }
+            return curr;
+        }
+
+        // Сдвигает текущую позицию только при успехе
+        template <typename T>
+        Expected<T> TryExpectNext()
+        {
+            auto next = PeekNext();
+            if (!next || !next->Is<T>())
+            {
+                return Diagnostic("Wrong token type", CurrentIndex() + 1);
+            }
+            ++current_token_;
+            return next->As<T>();
+        }
+
+        template <typename T, typename U>
+        Expected<T> TryExpectNext(const U &value)
+        {
+            auto next = PeekNext();
+            if (!next || !next->Is<T>() || next->As<T>().value != value)
+            {
+                return Diagnostic("Wrong token type", CurrentIndex() + 1);
+            }
+            ++current_token_;
+            return next->As<T>();
+        }
+
+    private:
+
+        // Читает строки источника до первой непустой разобранной и разбирает её в конец tokens_.
+        // На конце источника дописывает закрывающие Dedent и Eof и выставляет eof_
+        void ReadLine();
+        // Выдаёт очередную строку из потока или из отображённого файла
+        bool NextLine(std::string_view &line);
+        // Разбирает строку в конец tokens_. Строку с ошибкой в режиме ErrorPolicy::Collect
+        // пропускает целиком и возвращает false, в режиме ErrorPolicy::Throw выбрасывает LexerError
+        bool TokenizeLine(std::string_view line);
+        // Открывает файл path; при whole_source содержимое каналов читается в source_buffer_
+        void OpenFile(const std::filesystem::path &path, bool whole_source);
+        // Разбирает источник целиком (Eager) или до первого токена (Streaming)
+        void LoadTokens();
+        // Разбирает source_ целиком параллельно на threads потоках
+        void TokenizeParallel(size_t threads);
+        // Дописывает токен, полученный не разбором строки (Indent и Dedent на швах фрагментов,
+        // закрывающие Dedent и Eof, токены из кэша), и учитывает его в stats_
+        void PushSyntheticToken(Token token);
+        // Дописывает закрывающие Dedent и Eof и освобождает источник
+        void FinishTokens();
+        // Возвращает указатель на следующий токен (nullptr, если его нет), при необходимости
+        // дочитывая поток
+        const Token *PeekNext();
+        // Дочитывает поток, пока после текущего не окажется count токенов или он не закончится.
+        // В режиме Streaming перед дочитыванием освобождает пройденные токены.
+        // Возвращает true, если count токенов есть
+        bool FetchTokens(size_t count);
+        // Освобождает токены до текущего и до самой ранней метки (режим Streaming)
+        void ReleaseTokens();
+        // Ошибка с позицией токена index
+        [[nodiscard]] LexerDiagnostic Diagnostic(std::string message, size_t index) const;
+
+        LexerMode mode_;
+        ErrorPolicy error_policy_ = ErrorPolicy::Throw;
+        std::shared_ptr<symbols::SymbolTable> symbols_;
+        // Кэш имён перед symbols_ для последовательного разбора
+        symbols::SymbolCache symbol_cache_;
+        std::vector<LexerDiagnostic> errors_;
+        LexerStats stats_;
+        bool eof_ = false;
+        LineReader reader_;
+        std::unique_ptr<std::istream> file_;
+        MappedFile mapping_;
+        // Ещё не прочитанная часть отображённого файла
+        std::string_view source_;
+        // Содержимое потока, прочитанное целиком в режиме ZeroCopy
+        std::vector<char> source_buffer_;
+        StringArena unescaped_;
+        // Загруженный кэш токенов, на пул которого ссылаются токены String (режим ZeroCopy)
+        std::shared_ptr<const TokenStream> cache_;
+        uint32_t indent_level_ = 0;
+        // Номер последней прочитанной строки источника
+        size_t line_number_ = 0;
+
+        TokenBuffer tokens_;
+        size_t current_token_ = 0;
+        // Сколько токенов освобождено из начала tokens_ в режиме Streaming
+        size_t released_tokens_ = 0;
+        // Номера токенов, на которых стоят метки Mark, в порядке постановки
+        std::vector<size_t> marks_;
+        // Позиции всех токенов потока, включая освобождённые
+        TokenLocations locations_;
+    };
+
+    // Результат разбора одного файла функцией LexFiles
+    struct LexedFile
+    {
+        std::optional<Lexer> lexer; // пусто, если разбор завершился исключением
+        std::exception_ptr error;
+    };
+
+    // Разбирает файлы paths параллельно на пуле из threads потоков (0 - по числу ядер).
+    // Элемент i результата соответствует paths[i]
+    std::vector<LexedFile> LexFiles(const std::vector<std::filesystem::path> &paths,
+                                    LexerMode mode = LexerMode::Eager, size_t threads = 0);
+
+    // Лексер для часто редактируемого текста (например, буфера редактора).
+    // Токены хранятся отдельно для каждой строки, без Indent/Dedent: они зависят только
+    // от уровней отступа соседних строк и восстанавливаются при выдаче. Поэтому правка
+    // перечитывает лишь изменённые строки, а смена отступа влияет только на переход
+    // к следующей значимой строке, и ничего не нужно пересчитывать дальше
+    class IncrementalLexer
+    {
+    public:
+        // Имена Id интернируются в symbols; если она не задана, лексер заводит свою таблицу
+        explicit IncrementalLexer(std::string_view text = {}, std::shared_ptr<symbols::SymbolTable> symbols = nullptr);
+
+        // Заменяет строки [first_line, last_line) (нумерация с 0) строками text.
+        // Завершающий '\n' в text не порождает пустой строки. При ошибке разбора
+        // выбрасывает LexerError, оставляя текст прежним. Правка рядом с предыдущей стоит
+        // пропорционально числу правленых строк, см. lines_
+        void Edit(size_t first_line, size_t last_line, std::string_view text);
+
+        [[nodiscard]] size_t LineCount() const
+        {
+            return lines_.size() - gap_size_;
+        }
+
+        [[nodiscard]] const std::string &Line(size_t line) const
+        {
+            return At(line).text;
+        }
+
+        // Токены строки line без Indent/Dedent
+        [[nodiscard]] const std::vector<Token> &LineTokens(size_t line) const
+        {
+            return At(line).tokens;
+        }
+
+        class TokenIterator;
+        class TokenRange;
+
+        // Весь поток токенов, как его выдал бы Lexer для текущего текста. Токены строк не копируются,
+        // а Indent, Dedent и Eof порождаются при обходе. Диапазон действителен до следующей правки
+        [[nodiscard]] TokenRange Tokens() const;
+
+        // Число строк, разобранных последней правкой
+        [[nodiscard]] size_t LastRelexedLines() const
+        {
+            return last_relexed_;
+        }
+
+        // Таблица, в которой интернированы имена Id
+        [[nodiscard]] const std::shared_ptr<symbols::SymbolTable> &Symbols() const
+        {
+            return symbols_;
+        }
+
+    private:
+        struct SourceLine
+        {
+            std::string text;
+            std::vector<Token> tokens;
+            // Уровень отступа, если строка его задаёт (не пустая, не комментарий и не из одних отступов)
+            std::optional<uint32_t> level;
+        };
+
+        [[nodiscard]] const SourceLine &At(size_t line) const
+        {
+            return lines_[line < gap_begin_ ? line : line + gap_size_];
+        }
+
+        // Разбирает строки text; first_line - номер первой из них для сообщений об ошибках
+        std::vector<SourceLine> LexLines(std::string_view text, size_t first_line);
+        // Переносит разрыв так, чтобы он начинался перед строкой line
+        void MoveGap(size_t line);
+        // Расширяет разрыв не меньше чем до size элементов
+        void GrowGap(size_t size);
+
+        std::shared_ptr<symbols::SymbolTable> symbols_;
+        symbols::SymbolCache symbol_cache_;
+        // Буфер с разрывом: элементы [gap_begin_, gap_begin_ + gap_size_) свободны и стоят там,
+        // где была последняя правка. Правка сдвигает только строки между ней и предыдущей правкой,
+        // поэтому серия правок в одном месте стоит пропорционально правленым строкам, а правка
+        // далеко от предыдущей - ещё и расстоянию до неё (не больше числа строк файла)
+        std::vector<SourceLine> lines_;
+        size_t gap_begin_ = 0;
+        size_t gap_size_ = 0;
+        size_t last_relexed_ = 0;
+    };
+
+    // Итератор по потоку токенов IncrementalLexer: возвращает ссылки на токены строк,
+    // а между строками - на Indent и Dedent по их уровням отступа, в конце - на Dedent и Eof
+    class IncrementalLexer::TokenIterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Token;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Token *;
+        using reference = const Token &;
+
+        TokenIterator() = default;
+
+        const Token &operator*() const;
+
+        const Token *operator->() const
+        {
+            return &**this;
+        }
+
+        TokenIterator &operator++();
+
+        TokenIterator operator++(int)
+        {
+            auto copy = *this;
+            ++*this;
+            return copy;
+        }
+
+        bool operator==(const TokenIterator &other) const
+        {
+            return line_ == other.line_ && token_ == other.token_ && level_ == other.level_;
+        }
+
+    private:
+        friend class IncrementalLexer;
+
+        TokenIterator(const IncrementalLexer *lexer, size_t line) : lexer_(lexer), line_(line)
+        {
+            SkipEmptyLines();
+        }
+
+        // Переходит к первой строке, начиная с текущей, которая даёт токены или меняет отступ
+        void SkipEmptyLines();
+
+        const IncrementalLexer *lexer_ = nullptr;
+        // Номер строки; LineCount() - закрывающие Dedent и Eof, LineCount() + 1 - конец потока
+        size_t line_ = 0;
+        size_t token_ = 0;
+        // Уровень отступа, до которого уже выданы Indent и Dedent
+        uint32_t level_ = 0;
+    };
+
+    class IncrementalLexer::TokenRange : public std::ranges::view_interface<TokenRange>
+    {
+    public:
+        TokenRange() = default;
+        TokenRange(TokenIterator begin, TokenIterator end) : begin_(begin), end_(end) {}
+
+        [[nodiscard]] TokenIterator begin() const
+        {
+            return begin_;
+        }
+
+        [[nodiscard]] TokenIterator end() const
+        {
+            return end_;
         }
 
     private:
-        std::list<Token> tokens_;
-        std::list<Token>::iterator current_token_ = tokens_.end();
+        TokenIterator begin_;
+        TokenIterator end_;
     };
 
 } // namespace parse
\ No newline at end of file
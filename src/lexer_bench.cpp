@@ -0,0 +1,352 @@
+#include "bench_util.h"
+#include "lexer.h"
+#include "token_stream.h"
+
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <list>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+using bench::live_bytes;
+using bench::Measure;
+using bench::Run;
+
+namespace
+{
+    const char USAGE[] = "Usage: lexer_bench [BLOCKS]\n"
+                         "BLOCKS - number of class blocks in the generated program, 20000 by default\n";
+
+    // Разбирает положительное целое, записанное в arg целиком
+    bool ParseCount(string_view arg, size_t &count)
+    {
+        const auto [end, error] = from_chars(arg.data(), arg.data() + arg.size(), count);
+        return error == errc{} && end == arg.data() + arg.size() && count > 0;
+    }
+
+    // Программа из blocks повторений класса с методами, условиями и строками
+    string GenerateProgram(size_t blocks)
+    {
+        ostringstream out;
+        for (size_t i = 0; i < blocks; ++i)
+        {
+            out << "class Point" << i << ":\n"
+                << "  def __init__(self, x, y):\n"
+                << "    self.x = x\n"
+                << "    self.y = y\n"
+                << "\n"
+                << "  def __str__(self):\n"
+                << "    if self.x >= " << i << " and not self.y == None:\n"
+                << "      return str(self.x) + ' ' + str(self.y) # comment\n"
+                << "    else:\n"
+                << "      return \"point \\\"" << i << "\\\"\"\n"
+                << "p" << i << " = Point" << i << "(1, 2)\n"
+                << "print str(p" << i << ")\n";
+        }
+        return out.str();
+    }
+
+    // Код, почти целиком состоящий из ключевых слов и операторов
+    string GenerateKeywordProgram(size_t blocks)
+    {
+        ostringstream out;
+        for (size_t i = 0; i < blocks; ++i)
+        {
+            out << "if not True and False or None != x:\n"
+                << "  return None\n"
+                << "else:\n"
+                << "  print x <= y, x >= y, x == y, not x\n"
+                << "def f(self):\n"
+                << "  if True or False and not None:\n"
+                << "    return self.x + self.y * 2 - 1 / 3\n";
+        }
+        return out.str();
+    }
+
+    void Report(const string &name, size_t tokens, size_t source_size, const Measure &m)
+    {
+        cout << name << ": "
+             << tokens / m.seconds / 1e6 << " Mtokens/s, "
+             << source_size / m.seconds / (1 << 20) << " MB/s, "
+             << static_cast<double>(m.bytes) / tokens << " bytes/token, "
+             << static_cast<double>(m.allocations) / tokens << " allocs/token" << endl;
+    }
+
+    // Хранилище токенов: заполнение как в Lexer и многократный последовательный проход
+    template <typename Container>
+    void CompareStorage(const string &name, const vector<parse::Token> &source)
+    {
+        constexpr int walks = 10;
+        Container tokens;
+        size_t checksum = 0;
+
+        const size_t live_before = live_bytes;
+        auto fill = Run([&]
+                        {
+                            for (const auto &token : source)
+                            {
+                                tokens.push_back(token);
+                            } });
+        const size_t resident = live_bytes - live_before;
+        auto walk = Run([&]
+                        {
+                            for (int i = 0; i < walks; ++i)
+                            {
+                                for (const auto &token : tokens)
+                                {
+                                    checksum += token.index();
+                                }
+                            } });
+
+        cout << name << ": fill " << source.size() / fill.seconds / 1e6 << " Mtokens/s, "
+             << "walk " << source.size() * walks / walk.seconds / 1e6 << " Mtokens/s, "
+             << static_cast<double>(resident) / source.size() << " resident bytes/token, "
+             << static_cast<double>(fill.allocations) / source.size() << " allocs/token"
+             << " (checksum " << checksum << ")" << endl;
+    }
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    size_t blocks = 20000;
+    if (argc > 2 || (argc == 2 && !ParseCount(argv[1], blocks)))
+    {
+        cerr << USAGE;
+        return 2;
+    }
+    const string program = GenerateProgram(blocks);
+
+    size_t token_count = 0;
+    auto lex_mode = [&](parse::LexerMode mode, const string &program)
+    {
+        return Run([&]
+                   {
+                       token_count = 0;
+                       istringstream input(program);
+                       parse::Lexer lexer(input, mode);
+                       for (; !lexer.CurrentToken().Is<parse::token_type::Eof>(); lexer.NextToken())
+                       {
+                           ++token_count;
+                       } });
+    };
+    auto lex = lex_mode(parse::LexerMode::Eager, program);
+    cout << "source: " << program.size() << " bytes, " << token_count << " tokens, sizeof(Token) = "
+         << sizeof(parse::Token) << endl;
+    Report("Lexer (lex + walk)", token_count, program.size(), lex);
+    Report("Lexer ZeroCopy    ", token_count, program.size(), lex_mode(parse::LexerMode::ZeroCopy, program));
+    const size_t program_tokens = token_count;
+    auto generated = Run([&]
+                         {
+                             token_count = 0;
+                             istringstream input(program);
+                             for (const auto &token : parse::Lexer::Generate(input))
+                             {
+                                 token_count += !token.Is<parse::token_type::Eof>();
+                             } });
+    Report("Lexer::Generate   ", token_count, program.size(), generated);
+
+    // Пик памяти при проходе по токенам с меткой на начале каждой строки, как у разбора с возвратами
+    {
+        auto peak_memory = [&](parse::LexerMode mode)
+        {
+            istringstream input(program);
+            const size_t before = live_bytes;
+            size_t peak = 0;
+            parse::Lexer lexer(input, mode);
+            size_t mark = lexer.Mark();
+            for (; !lexer.CurrentToken().Is<parse::token_type::Eof>(); lexer.NextToken())
+            {
+                if (lexer.CurrentToken().Is<parse::token_type::Newline>())
+                {
+                    lexer.Commit(mark);
+                    mark = lexer.Mark();
+                }
+                peak = max(peak, live_bytes - before);
+            }
+            return peak;
+        };
+        cout << "Peak memory: Eager " << peak_memory(parse::LexerMode::Eager) / double(1 << 20)
+             << " MB, Streaming " << peak_memory(parse::LexerMode::Streaming) / 1024.0 << " KB" << endl;
+    }
+
+    // Чтение строк потока: std::getline против LineReader
+    {
+        size_t getline_bytes = 0;
+        size_t reader_bytes = 0;
+        auto by_getline = Run([&]
+                              {
+                                  istringstream input(program);
+                                  string line;
+                                  while (getline(input, line))
+                                  {
+                                      getline_bytes += line.size();
+                                  } });
+        auto by_reader = Run([&]
+                             {
+                                 istringstream input(program);
+                                 parse::LineReader reader(input, false);
+                                 string_view line;
+                                 while (reader.Next(line))
+                                 {
+                                     reader_bytes += line.size();
+                                 } });
+        cout << "Line reading: std::getline " << program.size() / by_getline.seconds / (1 << 20)
+             << " MB/s, LineReader " << program.size() / by_reader.seconds / (1 << 20) << " MB/s ("
+             << getline_bytes << " / " << reader_bytes << " bytes)" << endl;
+    }
+
+    const string keyword_program = GenerateKeywordProgram(blocks);
+    auto keywords = lex_mode(parse::LexerMode::Eager, keyword_program);
+    Report("Lexer keyword-dense", token_count, keyword_program.size(), keywords);
+
+    // Имена в Id - представления строк таблицы, поэтому она должна пережить лексер
+    auto symbol_table = make_shared<symbols::SymbolTable>();
+    vector<parse::Token> tokens;
+    {
+        istringstream input(program);
+        parse::Lexer lexer(input, parse::LexerMode::Eager, parse::ErrorPolicy::Throw, symbol_table);
+        for (; !lexer.CurrentToken().Is<parse::token_type::Eof>(); lexer.NextToken())
+        {
+            tokens.push_back(lexer.CurrentToken());
+        }
+    }
+
+    // Сравнение прежнего хранилища Lexer (std::list) с нынешним на одной последовательности токенов
+    CompareStorage<list<parse::Token>>("std::list<Token>  ", tokens);
+    CompareStorage<vector<parse::Token>>("std::vector<Token>", tokens);
+
+    // Компактное представление: объём и проход с проверкой типа лексемы
+    {
+        constexpr int walks = 10;
+        parse::TokenStream stream;
+        const size_t live_before = live_bytes;
+        auto fill = Run([&]
+                        {
+                            for (const auto &token : tokens)
+                            {
+                                stream.PushBack(token);
+                            } });
+        const size_t resident = live_bytes - live_before;
+        size_t vector_newlines = 0;
+        size_t stream_newlines = 0;
+        auto vector_walk = Run([&]
+                               {
+                                   for (int i = 0; i < walks; ++i)
+                                   {
+                                       for (const auto &token : tokens)
+                                       {
+                                           vector_newlines += token.Is<parse::token_type::Newline>();
+                                       }
+                                   } });
+        auto stream_walk = Run([&]
+                               {
+                                   for (int i = 0; i < walks; ++i)
+                                   {
+                                       for (size_t j = 0; j < stream.Size(); ++j)
+                                       {
+                                           stream_newlines += stream.Is<parse::token_type::Newline>(j);
+                                       }
+                                   } });
+        cout << "TokenStream       : fill " << tokens.size() / fill.seconds / 1e6 << " Mtokens/s, "
+             << static_cast<double>(resident) / tokens.size() << " resident bytes/token, "
+             << static_cast<double>(stream.MemoryUsage()) / tokens.size() << " used bytes/token" << endl;
+        cout << "Newline scan: vector<Token> " << tokens.size() * walks / vector_walk.seconds / 1e6
+             << " Mtokens/s, TokenStream " << tokens.size() * walks / stream_walk.seconds / 1e6
+             << " Mtokens/s (" << vector_newlines << " / " << stream_newlines << ")" << endl;
+    }
+
+    // Правка одной строки: IncrementalLexer против полного разбора
+    {
+        constexpr int edits = 1000;
+        parse::IncrementalLexer incremental(program);
+        const size_t lines = incremental.LineCount();
+        auto edit = Run([&]
+                        {
+                            for (int i = 0; i < edits; ++i)
+                            {
+                                const size_t line = i * 7919 % lines;
+                                incremental.Edit(line, line + 1, incremental.Line(line) + " # edited"s);
+                            } });
+        auto full = Run([&]
+                        {
+                            istringstream input(program);
+                            parse::Lexer lexer(input); });
+        cout << "Single-line edit: IncrementalLexer " << edit.seconds / edits * 1e6 << " us, full re-lex "
+             << full.seconds * 1e6 << " us" << endl;
+
+        // Вставка и удаление строк в одном месте, как при наборе текста: сдвигов строк нет
+        const size_t middle = lines / 2;
+        auto insert = Run([&]
+                          {
+                              for (int i = 0; i < edits; ++i)
+                              {
+                                  incremental.Edit(middle + i, middle + i, "x = 1\n"sv);
+                              }
+                              incremental.Edit(middle, middle + edits, ""sv); });
+        cout << "Line insert/erase: IncrementalLexer " << insert.seconds / (edits + 1) * 1e6 << " us" << endl;
+
+        // Обход потока после правки, как его делает разбор
+        constexpr int walks = 20;
+        size_t newlines = 0;
+        auto walk = Run([&]
+                        {
+                            for (int i = 0; i < walks; ++i)
+                            {
+                                for (const auto &token : incremental.Tokens())
+                                {
+                                    newlines += token.Is<parse::token_type::Newline>();
+                                }
+                            } });
+        cout << "IncrementalLexer::Tokens walk: " << walk.seconds / walks * 1e6 << " us, "
+             << static_cast<double>(walk.allocations) / walks << " allocs (" << newlines / walks << " newlines)"
+             << endl;
+    }
+
+    // Масштабирование параллельного разбора одного файла по числу потоков
+    const auto path = filesystem::temp_directory_path() / "mython_lexer_bench.my";
+    ofstream(path) << program;
+    const size_t max_threads = max(4u, thread::hardware_concurrency());
+    double serial_seconds = 0;
+    for (size_t threads = 1; threads <= max_threads; threads *= 2)
+    {
+        auto parallel = Run([&]
+                            { parse::Lexer lexer(path, parse::LexerMode::ZeroCopy, threads); });
+        if (threads == 1)
+        {
+            serial_seconds = parallel.seconds;
+        }
+        Report("File ZeroCopy, " + to_string(threads) + " threads", program_tokens, program.size(), parallel);
+        cout << "  speedup x" << serial_seconds / parallel.seconds << endl;
+    }
+
+    // Загрузка из кэша токенов против разбора заново. Обе стороны - в одном режиме: в Eager
+    // строки из кэша копируются, в ZeroCopy ссылаются на пул кэша
+    const auto cache = filesystem::temp_directory_path() / "mython_lexer_bench.mytok";
+    const pair<parse::LexerMode, const char *> cache_modes[] = {{parse::LexerMode::Eager, "Eager"},
+                                                                {parse::LexerMode::ZeroCopy, "ZeroCopy"}};
+    for (const auto &[mode, mode_name] : cache_modes)
+    {
+        filesystem::remove(cache);
+        auto fresh = Run([&]
+                         { parse::Lexer lexer(path, mode); });
+        auto miss = Run([&]
+                        { parse::Lexer lexer(path, cache, mode); });
+        auto hit = Run([&]
+                       { parse::Lexer lexer(path, cache, mode); });
+        cout << "Token cache, " << mode_name << " (" << filesystem::file_size(cache) << " bytes): fresh lex "
+             << fresh.seconds * 1e3 << " ms, lex + write " << miss.seconds * 1e3 << " ms, Lexer from cache "
+             << hit.seconds * 1e3 << " ms, speedup x" << fresh.seconds / hit.seconds << endl;
+    }
+    auto load = Run([&]
+                    { parse::TokenStream::Load(cache, parse::HashSource(program)); });
+    cout << "TokenStream::Load " << load.seconds * 1e3 << " ms" << endl;
+    filesystem::remove(cache);
+    filesystem::remove(path);
+}
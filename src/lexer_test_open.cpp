@@ -1,6 +1,10 @@
 #include "lexer.h"
+#include "char_scan.h"
+#include "token_stream.h"
 #include "test_runner_p.h"
 
+#include <filesystem>
+#include <fstream>
 #include <sstream>
 #include <string>
 
@@ -373,6 +377,1072 @@ abc#
                 ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
             }
         }
+
+        void TestStreamingMode()
+        {
+            const string program = R"(
+class Point:
+  def __init__(self, x):
+    self.x = x # comment
+
+    if x >= 0:
+      print 'positive', "\"x\""
+p = Point(1)
+)"s;
+            istringstream eager_input(program);
+            Lexer eager(eager_input);
+            istringstream stream_input(program);
+            Lexer streaming(stream_input, LexerMode::Streaming);
+
+            ASSERT_EQUAL(streaming.CurrentToken(), eager.CurrentToken());
+            while (eager.CurrentToken() != Token(token_type::Eof{}))
+            {
+                ASSERT_EQUAL(streaming.NextToken(), eager.NextToken());
+            }
+            ASSERT_EQUAL(streaming.NextToken(), Token(token_type::Eof{}));
+
+            istringstream is("+ bugaga\n  + def 52"s);
+            Lexer lex(is, LexerMode::Streaming);
+            ASSERT_EQUAL(lex.CurrentToken(), Token(token_type::Char{'+'}));
+            ASSERT_DOESNT_THROW(lex.ExpectNext<token_type::Id>("bugaga"s));
+            ASSERT_THROWS(lex.ExpectNext<token_type::Char>('+'), LexerError);
+            ASSERT_DOESNT_THROW(lex.ExpectNext<token_type::Newline>());
+            ASSERT_DOESNT_THROW(lex.ExpectNext<token_type::Indent>());
+            ASSERT_EQUAL(lex.NextToken(), Token(token_type::Char{'+'}));
+            ASSERT_EQUAL(lex.NextToken(), Token(token_type::Def{}));
+            ASSERT_EQUAL(lex.NextToken(), Token(token_type::Number{52}));
+            ASSERT_EQUAL(lex.NextToken(), Token(token_type::Newline{}));
+            ASSERT_EQUAL(lex.NextToken(), Token(token_type::Dedent{}));
+            ASSERT_EQUAL(lex.NextToken(), Token(token_type::Eof{}));
+            ASSERT_EQUAL(lex.NextToken(), Token(token_type::Eof{}));
+        }
+
+        void TestFileInput()
+        {
+            const string program = "x = 'a' + \"b\"\nif x != y:\n  print x\n\n# end\ny=x<=3"s;
+            const auto path = filesystem::temp_directory_path() / "mython_lexer_test.my";
+            {
+                ofstream out(path);
+                out << program;
+            }
+
+            for (auto mode : {LexerMode::Eager, LexerMode::Streaming})
+            {
+                istringstream input(program);
+                Lexer expected(input);
+                Lexer lexer(path, mode);
+
+                ASSERT_EQUAL(lexer.CurrentToken(), expected.CurrentToken());
+                while (expected.CurrentToken() != Token(token_type::Eof{}))
+                {
+                    ASSERT_EQUAL(lexer.NextToken(), expected.NextToken());
+                }
+                ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
+            }
+
+            filesystem::remove(path);
+            ASSERT_THROWS(Lexer lexer(path), LexerError);
+            // Каталог открывается на чтение, но отобразить его нельзя
+            ASSERT_THROWS(MappedFile::Open(filesystem::temp_directory_path()), LexerError);
+        }
+
+        void TestZeroCopyMode()
+        {
+            const string program = "name = 'plain' + \"esc\\taped\\\"\"\nprint name_with_a_long_identifier\n"s;
+            istringstream eager_input(program);
+            Lexer eager(eager_input);
+            istringstream zero_copy_input(program);
+            Lexer lexer(zero_copy_input, LexerMode::ZeroCopy);
+
+            ASSERT_EQUAL(lexer.CurrentToken(), eager.CurrentToken());
+            while (eager.CurrentToken() != Token(token_type::Eof{}))
+            {
+                ASSERT_EQUAL(lexer.NextToken(), eager.NextToken());
+            }
+
+            istringstream input(program);
+            Lexer strings(input, LexerMode::ZeroCopy);
+            strings.NextToken();
+            ASSERT(strings.ExpectNext<token_type::String>().value.IsView());
+            ASSERT_EQUAL(strings.CurrentToken(), Token(token_type::String{"plain"s}));
+            strings.NextToken();
+            ASSERT(strings.ExpectNext<token_type::String>().value.IsView());
+            ASSERT_EQUAL(strings.CurrentToken(), Token(token_type::String{"esc\taped\""s}));
+
+            // Имена Id не копируются: они ссылаются на строку из таблицы символов лексера
+            istringstream id_input(program);
+            Lexer ids(id_input, LexerMode::ZeroCopy);
+            const auto &name = ids.Expect<token_type::Id>();
+            ASSERT(name.value.IsView());
+            ASSERT(name.value.View().data() == ids.Symbols()->Name(name.symbol).data());
+            const std::string name_copy = name.value;
+            ASSERT_EQUAL(name_copy, "name"s);
+
+            // Вне ZeroCopy строки владеют текстом, и value по-прежнему присваивается std::string
+            istringstream owned_input(program);
+            Lexer owned(owned_input, LexerMode::Streaming);
+            owned.NextToken();
+            ASSERT(!owned.ExpectNext<token_type::String>().value.IsView());
+            const std::string plain = owned.Expect<token_type::String>().value;
+            ASSERT_EQUAL(plain, "plain"s);
+        }
+
+        void TestIdsAreInterned()
+        {
+            istringstream input("counter = counter + other_counter\n"s);
+            Lexer lexer(input);
+
+            auto first = lexer.Expect<token_type::Id>().symbol;
+            lexer.NextToken();
+            ASSERT_EQUAL(lexer.ExpectNext<token_type::Id>().symbol, first);
+            lexer.NextToken();
+            ASSERT(lexer.ExpectNext<token_type::Id>().symbol != first);
+
+            // Имя остаётся строкой, а номер относится к таблице лексера
+            const std::string name = lexer.Expect<token_type::Id>().value;
+            ASSERT_EQUAL(name, "other_counter"s);
+            ASSERT_EQUAL(token_type::Id{"counter"s}.symbol, symbols::NO_SYMBOL);
+            ASSERT_EQUAL(lexer.Symbols()->Name(first), "counter"sv);
+            ASSERT_EQUAL(lexer.Symbols()->Intern("other_counter"sv).id, lexer.Expect<token_type::Id>().symbol);
+
+            // Лексеры частей одной программы получают общие номера через общую таблицу
+            istringstream other_input("other_counter = counter\n"s);
+            Lexer other(other_input, LexerMode::Eager, ErrorPolicy::Throw, lexer.Symbols());
+            ASSERT_EQUAL(other.Expect<token_type::Id>().symbol, lexer.Expect<token_type::Id>().symbol);
+            other.NextToken();
+            ASSERT_EQUAL(other.ExpectNext<token_type::Id>().symbol, first);
+
+            // Без общей таблицы у каждого лексера своя, и она освобождается вместе с ним
+            std::weak_ptr<symbols::SymbolTable> own;
+            {
+                istringstream own_input("x\n"s);
+                Lexer own_lexer(own_input);
+                own = own_lexer.Symbols();
+                ASSERT(own.lock() != lexer.Symbols());
+            }
+            ASSERT(own.expired());
+        }
+
+        void TestCharScanKernels()
+        {
+            const string text = "abc_XYZ_0123456789_abcdefghijklmnopqrstuvwxyz_ABCDEFGHIJ \t\r\n  \t  \v\f"
+                                "0123456789012345678901234567890123456789+plain text with no stop 'quoted\\'\xD0\x9F"s;
+
+            for (auto isa : {scan::Isa::Scalar, scan::Isa::Sse2, scan::Isa::Avx2})
+            {
+                scan::SetIsa(isa);
+                for (size_t pos = 0; pos <= text.size(); ++pos)
+                {
+                    string_view rest = string_view(text).substr(pos);
+                    auto expected = [&](auto cls)
+                    {
+                        size_t n = 0;
+                        while (n < rest.size() && cls(rest[n]))
+                        {
+                            ++n;
+                        }
+                        return n;
+                    };
+                    const string hint = scan::IsaName(scan::ActiveIsa()) + " at "s + to_string(pos);
+
+                    AssertEqual(scan::IdentifierLength(rest), expected(scan::IsIdentifierChar), hint);
+                    AssertEqual(scan::DigitsLength(rest), expected(scan::IsDigit), hint);
+                    AssertEqual(scan::SpacesLength(rest), expected(scan::IsSpace), hint);
+                    AssertEqual(scan::IndentLength(rest), expected([](char c)
+                                                                   { return c == ' ' || c == '\t' || c == '\n'; }),
+                                hint);
+                    AssertEqual(scan::FindQuoteOrBackslash(rest, '\''), expected([](char c)
+                                                                                 { return c != '\'' && c != '\\'; }),
+                                hint);
+                }
+            }
+            scan::SetIsa(scan::BestIsa());
+        }
+
+        void TestUtf8Validation()
+        {
+            // Пары "текст - позиция первой ошибки"; ошибки стоят и в начале, и в хвосте блоков SIMD
+            const string cyrillic = "Привет, мир! Съешь же ещё этих мягких французских булок"s;
+            const string padding(29, 'a');
+            const vector<pair<string, size_t>> cases = {
+                {""s, 0},
+                {"plain ascii text"s, 16},
+                {cyrillic, cyrillic.size()},
+                {padding + "\xF0\x9F\x98\x80"s + cyrillic, padding.size() + 4 + cyrillic.size()},
+                {"\xE2\x82\xAC \xEF\xBF\xBF \xF4\x8F\xBF\xBF"s, 12},
+                {"abc\x80"s, 3},                          // продолжение без начала
+                {padding + "\xD0"s, padding.size()},       // оборванная последовательность в конце
+                {padding + "\xE2\x82"s + "ab"s, padding.size()},
+                {"\xC0\xAF"s, 0},                         // избыточно длинная запись
+                {"x\xE0\x80\xAF"s, 1},
+                {"\xED\xA0\x80"s, 0},                    // суррогат
+                {cyrillic + "\xF4\x90\x80\x80"s, cyrillic.size()}, // больше U+10FFFF
+                {cyrillic + "\xFF"s + padding, cyrillic.size()},
+                {padding + padding + "\xD0\x9F\x9F"s, 2 * padding.size() + 2},
+            };
+
+            for (auto isa : {scan::Isa::Scalar, scan::Isa::Sse2, scan::Isa::Avx2})
+            {
+                scan::SetIsa(isa);
+                for (const auto &[text, expected] : cases)
+                {
+                    AssertEqual(scan::Utf8ErrorPosition(text), expected, scan::IsaName(scan::ActiveIsa()) + " "s + text);
+                }
+            }
+            scan::SetIsa(scan::BestIsa());
+
+            size_t pos = 0;
+            ASSERT_EQUAL(static_cast<uint32_t>(scan::DecodeUtf8("Ж"sv, pos)), 0x416u);
+            ASSERT_EQUAL(pos, 2u);
+            ASSERT(scan::IsIdentifierCodePoint(U'ж'));
+            ASSERT(scan::IsIdentifierCodePoint(U'é'));
+            ASSERT(!scan::IsIdentifierCodePoint(U'«'));
+            ASSERT(!scan::IsIdentifierCodePoint(U'—'));
+        }
+
+        void TestUnicodeIdentifiers()
+        {
+            istringstream input("счётчик = счётчик + x_ёж2\n"
+                                "print 'Привет, мир', счётчик\n"s);
+            Lexer lexer(input);
+
+            ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Id{"счётчик"s}));
+            ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
+            ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"счётчик"s}));
+            ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'+'}));
+            ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"x_ёж2"s}));
+            ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+            ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Print{}));
+            ASSERT_EQUAL(lexer.NextToken(), Token(token_type::String{"Привет, мир"s}));
+            ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{','}));
+            ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"счётчик"s}));
+
+            // Знак пунктуации вне ASCII - не часть идентификатора
+            istringstream punct_input("x = «y»\n"s);
+            Lexer punct(punct_input, LexerMode::Eager, ErrorPolicy::Collect);
+            ASSERT_EQUAL(punct.Errors().size(), 1u);
+            ASSERT_EQUAL(punct.Errors()[0].column, 5u);
+            ASSERT_EQUAL(punct.Errors()[0].message, "Unexpected character «"s);
+
+            // Некорректный UTF-8 - ошибка в позиции первого неверного байта, даже в строке
+            istringstream invalid_input("x = 1\ny = 'ab\xD0'\n"s);
+            Lexer invalid(invalid_input, LexerMode::Eager, ErrorPolicy::Collect);
+            ASSERT_EQUAL(invalid.Errors().size(), 1u);
+            ASSERT_EQUAL(invalid.Errors()[0].line, 2u);
+            ASSERT_EQUAL(invalid.Errors()[0].column, 8u);
+        }
+
+        void TestTokenRelease()
+        {
+            string program;
+            for (int i = 0; i < 2000; ++i)
+            {
+                program += "class C"s + to_string(i) + ":\n  def f(self, x):\n    return x + "s + to_string(i) + "\n"s;
+            }
+            istringstream eager_input(program);
+            Lexer eager(eager_input);
+            istringstream stream_input(program);
+            Lexer lexer(stream_input, LexerMode::Streaming);
+
+            // Разбор с возвратом: каждая строка читается дважды от метки в её начале
+            size_t max_buffered = 0;
+            while (!lexer.CurrentToken().Is<token_type::Eof>())
+            {
+                const size_t mark = lexer.Mark();
+                while (!lexer.CurrentToken().Is<token_type::Newline>() && !lexer.CurrentToken().Is<token_type::Eof>())
+                {
+                    lexer.NextToken();
+                }
+                const size_t end = lexer.CurrentIndex();
+                lexer.Rewind(mark);
+                for (; lexer.CurrentIndex() < end; lexer.NextToken())
+                {
+                    ASSERT_EQUAL(lexer.CurrentToken(), eager.CurrentToken());
+                    eager.NextToken();
+                    max_buffered = max(max_buffered, lexer.BufferedTokens());
+                }
+                ASSERT_EQUAL(lexer.CurrentToken(), eager.CurrentToken());
+                lexer.Commit(mark);
+                if (lexer.CurrentToken().Is<token_type::Newline>())
+                {
+                    lexer.NextToken();
+                    eager.NextToken();
+                }
+            }
+            ASSERT(eager.CurrentToken().Is<token_type::Eof>());
+            // В памяти только окно из текущей строки и сохраняемых пройденных токенов, а не вся программа
+            ASSERT(max_buffered < 3 * Lexer::RETAINED_TOKENS);
+            ASSERT_THROWS(lexer.Rewind(0), std::out_of_range);
+            ASSERT(!lexer.Location(0));
+            ASSERT(lexer.CurrentLocation());
+
+            // Пока метка не снята, токены от неё не освобождаются
+            istringstream pinned_input(program);
+            Lexer pinned(pinned_input, LexerMode::Streaming);
+            const size_t start = pinned.Mark();
+            for (int i = 0; i < 1000; ++i)
+            {
+                pinned.NextToken();
+            }
+            ASSERT(pinned.BufferedTokens() > 1000);
+            pinned.Rewind(start);
+            ASSERT_EQUAL(pinned.CurrentToken(), Token(token_type::Class{}));
+            pinned.Commit(start);
+            // Уже прочитанные токены проходятся заново, освобождение начинается с дочитывания
+            for (int i = 0; i < 2000; ++i)
+            {
+                pinned.NextToken();
+            }
+            ASSERT(pinned.BufferedTokens() < 3 * Lexer::RETAINED_TOKENS);
+        }
+
+        void TestStreamingReferencesStayValid()
+        {
+            string program;
+            for (int i = 0; i < 500; ++i)
+            {
+                program += "print 'str"s + to_string(i) + "'\n"s;
+            }
+            istringstream input(program);
+            Lexer lexer(input, LexerMode::Streaming);
+
+            // Ссылки на токены не меняются, пока лексер уходит вперёд и освобождает старые токены
+            int checked = 0;
+            while (lexer.CurrentToken() != token_type::Eof{})
+            {
+                if (lexer.CurrentToken() != token_type::Print{})
+                {
+                    lexer.NextToken();
+                    continue;
+                }
+                const Token &print = lexer.CurrentToken();
+                const auto &str = lexer.ExpectNext<token_type::String>();
+                const Token &newline = lexer.PeekToken(1);
+                const string expected(str.value.View());
+                for (size_t step = 0; step + 2 < Lexer::RETAINED_TOKENS; ++step)
+                {
+                    lexer.PeekToken(Lexer::MAX_LOOKAHEAD);
+                    lexer.NextToken();
+                }
+                ASSERT_EQUAL(print, Token(token_type::Print{}));
+                ASSERT_EQUAL(str.value.View(), expected);
+                ASSERT_EQUAL(newline, Token(token_type::Newline{}));
+                ++checked;
+            }
+            ASSERT(checked > 10);
+
+            // Токены от неснятой метки не перемещаются, а Rewind возвращает к тем же токенам
+            istringstream marked_input(program);
+            Lexer marked(marked_input, LexerMode::Streaming);
+            const size_t mark = marked.Mark();
+            const Token &first = marked.CurrentToken();
+            const auto &first_str = marked.ExpectNext<token_type::String>();
+            for (int i = 0; i < 1000; ++i)
+            {
+                marked.NextToken();
+            }
+            marked.Rewind(mark);
+            ASSERT_EQUAL(&marked.CurrentToken(), &first);
+            ASSERT_EQUAL(&marked.ExpectNext<token_type::String>(), &first_str);
+            ASSERT_EQUAL(first_str.value.View(), "str0"sv);
+
+            // После снятия метки ссылки живут ещё не меньше RETAINED_TOKENS шагов
+            marked.Commit(mark);
+            for (size_t step = 0; step + 2 < Lexer::RETAINED_TOKENS; ++step)
+            {
+                marked.NextToken();
+            }
+            ASSERT_EQUAL(first, Token(token_type::Print{}));
+            ASSERT_EQUAL(first_str.value.View(), "str0"sv);
+        }
+
+        void TestCarriageReturnIsWhitespace()
+        {
+            istringstream input("x = 1\r\nif x:\r\n  print x\r\n"s);
+            Lexer lexer(input);
+
+            ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Id{"x"s}));
+            ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
+            ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Number{1}));
+            ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+            ASSERT_EQUAL(lexer.NextToken(), Token(token_type::If{}));
+            ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"x"s}));
+            ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{':'}));
+            ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+            ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Indent{}));
+        }
+
+        void TestLexersKeepOwnIndentation()
+        {
+            istringstream first_input("a\n  b\n    c\n"s);
+            istringstream second_input("x\ny\n"s);
+            Lexer first(first_input, LexerMode::Streaming);
+            ASSERT_EQUAL(first.NextToken(), Token(token_type::Newline{}));
+            ASSERT_EQUAL(first.NextToken(), Token(token_type::Indent{}));
+
+            // Второй лексер создаётся, пока первый стоит на отступе, и не должен его видеть
+            Lexer second(second_input, LexerMode::Streaming);
+            ASSERT_EQUAL(first.NextToken(), Token(token_type::Id{"b"s}));
+            ASSERT_EQUAL(second.CurrentToken(), Token(token_type::Id{"x"s}));
+            ASSERT_EQUAL(second.NextToken(), Token(token_type::Newline{}));
+            ASSERT_EQUAL(second.NextToken(), Token(token_type::Id{"y"s}));
+            ASSERT_EQUAL(second.NextToken(), Token(token_type::Newline{}));
+            ASSERT_EQUAL(second.NextToken(), Token(token_type::Eof{}));
+            ASSERT_EQUAL(first.NextToken(), Token(token_type::Newline{}));
+            ASSERT_EQUAL(first.NextToken(), Token(token_type::Indent{}));
+            ASSERT_EQUAL(first.NextToken(), Token(token_type::Id{"c"s}));
+            ASSERT_EQUAL(first.NextToken(), Token(token_type::Newline{}));
+            ASSERT_EQUAL(first.NextToken(), Token(token_type::Dedent{}));
+            ASSERT_EQUAL(first.NextToken(), Token(token_type::Dedent{}));
+            ASSERT_EQUAL(first.NextToken(), Token(token_type::Eof{}));
+        }
+
+        void TestLexFiles()
+        {
+            const auto dir = filesystem::temp_directory_path();
+            vector<filesystem::path> paths;
+            vector<string> programs;
+            for (int i = 0; i < 16; ++i)
+            {
+                ostringstream program;
+                for (int depth = 0; depth <= i % 5; ++depth)
+                {
+                    program << string(depth * 2, ' ') << "if x" << i << " >= " << depth << ":\n";
+                }
+                program << string((i % 5 + 1) * 2, ' ') << "print 'file " << i << "'\n";
+                programs.push_back(program.str());
+                paths.push_back(dir / ("mython_lex_files_"s + to_string(i) + ".my"s));
+                ofstream(paths.back()) << programs.back();
+            }
+            paths.push_back(dir / "mython_lex_files_missing.my"s);
+
+            auto lexed = LexFiles(paths, LexerMode::Eager, 4);
+            ASSERT_EQUAL(lexed.size(), paths.size());
+            for (size_t i = 0; i < programs.size(); ++i)
+            {
+                ASSERT(!lexed[i].error);
+                istringstream input(programs[i]);
+                Lexer expected(input);
+                Lexer &lexer = *lexed[i].lexer;
+                ASSERT_EQUAL(lexer.CurrentToken(), expected.CurrentToken());
+                while (expected.CurrentToken() != Token(token_type::Eof{}))
+                {
+                    ASSERT_EQUAL(lexer.NextToken(), expected.NextToken());
+                }
+                filesystem::remove(paths[i]);
+            }
+            ASSERT(!lexed.back().lexer);
+            ASSERT_THROWS(rethrow_exception(lexed.back().error), LexerError);
+        }
+        void TestParallelFileLexing()
+        {
+            // Фрагменты начинаются на разной глубине, среди строк есть пустые,
+            // из одних пробелов и комментарии с произвольным отступом
+            ostringstream program;
+            for (int i = 0; program.tellp() < 1200 * 1024; ++i)
+            {
+                const int depth = i % 7;
+                for (int level = 0; level <= depth; ++level)
+                {
+                    program << string(level * 2, ' ') << "if x" << i << " >= " << level << ":\n";
+                    if (level % 3 == 1)
+                    {
+                        program << "\n"
+                                << string(level * 4 + 1, ' ') << "\n"
+                                << string(i % 9, ' ') << "# comment " << i << "\n";
+                    }
+                }
+                program << string((depth + 1) * 2, ' ') << "print 'line\\n" << i << "', \"q\\\"\"\n";
+            }
+            const auto path = filesystem::temp_directory_path() / "mython_parallel_lexing.my"s;
+            ofstream(path) << program.str();
+
+            for (auto mode : {LexerMode::Eager, LexerMode::ZeroCopy})
+            {
+                Lexer expected(path, mode);
+                Lexer lexer(path, mode, 4);
+                ASSERT_EQUAL(lexer.CurrentToken(), expected.CurrentToken());
+                uint64_t count = 1;
+                while (expected.CurrentToken() != Token(token_type::Eof{}))
+                {
+                    ASSERT_EQUAL(lexer.NextToken(), expected.NextToken());
+                    ++count;
+                }
+                ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
+
+                // Токены на швах фрагментов учитываются так же, как при последовательном разборе
+                if constexpr (LexerStats::ENABLED)
+                {
+                    ASSERT(lexer.Stats().tokens == expected.Stats().tokens);
+                    ASSERT_EQUAL(lexer.Stats().TotalTokens(), count);
+                }
+            }
+            filesystem::remove(path);
+        }
+        void TestTokenStream()
+        {
+            const string program = "x = 4 + -2147483647 + 2147483648\n"
+                                   "if x >= 0 and not y:\n"
+                                   "  print 'a\\tb', \"\", x.y\n"
+                                   "# comment\n"
+                                   "class C:\n"
+                                   "  def f(self):\n"
+                                   "    return None != True\n"s;
+            istringstream input(program);
+            Lexer lexer(input, LexerMode::Streaming);
+            TokenStream stream(lexer);
+
+            istringstream expected_input(program);
+            Lexer expected(expected_input);
+            size_t i = 0;
+            for (const Token &token : stream)
+            {
+                ASSERT_EQUAL(token, expected.CurrentToken());
+                ASSERT_EQUAL(stream.Kind(i++), expected.CurrentToken().index());
+                expected.NextToken();
+            }
+            ASSERT_EQUAL(i, stream.Size());
+            ASSERT(stream.Is<token_type::Eof>(stream.Size() - 1));
+            ASSERT(stream.Is<token_type::Id>(0));
+            ASSERT(stream.MemoryUsage() < stream.Size() * sizeof(Token));
+        }
+        void TestTokenCache()
+        {
+            const auto dir = filesystem::temp_directory_path();
+            const auto source = dir / "mython_token_cache.my"s;
+            const auto cache = dir / "mython_token_cache.mytok"s;
+            filesystem::remove(cache);
+
+            auto check = [&](const string &program)
+            {
+                ofstream(source) << program;
+                istringstream input(program);
+                Lexer expected(input);
+                Lexer lexer(source, cache);
+                ASSERT_EQUAL(lexer.CurrentToken(), expected.CurrentToken());
+                while (expected.CurrentToken() != Token(token_type::Eof{}))
+                {
+                    // Строки из кэша в режиме Eager не ссылаются на его пул
+                    if (const auto *str = lexer.CurrentToken().TryAs<token_type::String>())
+                    {
+                        ASSERT(!str->value.IsView());
+                    }
+                    ASSERT_EQUAL(lexer.NextToken(), expected.NextToken());
+                }
+            };
+
+            const string program = "class Counter:\n"
+                                   "  def add(self, n):\n"
+                                   "    self.value = self.value + n * 10000000000\n"
+                                   "    print 'added\\n', n, \"!\"\n"s;
+            check(program);
+            ASSERT(filesystem::exists(cache));
+            ASSERT(TokenStream::Load(cache, HashSource(program)));
+            ASSERT(!TokenStream::Load(cache, HashSource(program + "x"s)));
+            // Повторный разбор берёт токены из кэша
+            check(program);
+
+            // Изменённый исходник разбирается заново, кэш перезаписывается
+            const string changed = program + "if x != 'y':\n  print x\n"s;
+            check(changed);
+            ASSERT(TokenStream::Load(cache, HashSource(changed)));
+
+            // Обрезанный кэш отвергается
+            filesystem::resize_file(cache, filesystem::file_size(cache) - 3);
+            ASSERT(!TokenStream::Load(cache, HashSource(changed)));
+            check(changed);
+
+            filesystem::remove(source);
+            filesystem::remove(cache);
+        }
+        void TestLineReader()
+        {
+            // Строки разной длины, в том числе длиннее блока и пересекающие его границы
+            ostringstream text;
+            for (size_t i = 0; i < 3000; ++i)
+            {
+                text << string(i * 37 % 101, 'a' + i % 26) << (i % 7 == 0 ? "\n\n"s : "\n"s);
+            }
+            text << string(200 * 1024, 'z') << "\n"
+                 << "last line without newline";
+
+            for (bool lazy : {false, true})
+            {
+                istringstream expected(text.str());
+                istringstream input(text.str());
+                LineReader reader(input, lazy);
+                string expected_line;
+                string_view line;
+                while (getline(expected, expected_line))
+                {
+                    ASSERT(reader.Next(line));
+                    ASSERT_EQUAL(line, expected_line);
+                }
+                ASSERT(!reader.Next(line));
+                ASSERT(input.eof());
+            }
+
+            istringstream input(text.str());
+            vector<char> all;
+            LineReader::ReadAll(input, all);
+            ASSERT_EQUAL(string(all.begin(), all.end()), text.str());
+        }
+        void TestLargeNumbers()
+        {
+            istringstream input("2147483647 2147483648 007 9223372036854775807\n"s);
+            Lexer lexer(input);
+
+            ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Number{2147483647}));
+            ASSERT_EQUAL(lexer.NextToken(), Token(token_type::BigNumber{2147483648}));
+            ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Number{7}));
+            ASSERT_EQUAL(lexer.NextToken(), Token(token_type::BigNumber{9223372036854775807}));
+
+            const string overflow = "x = 1\n\nif x:\n  y = 99999999999999999999 + 1\n"s;
+            try
+            {
+                istringstream bad_input(overflow);
+                Lexer bad(bad_input);
+                ASSERT(false);
+            }
+            catch (const LexerError &e)
+            {
+                ASSERT_EQUAL(e.Line(), 4u);
+                ASSERT_EQUAL(e.Column(), 7u);
+            }
+
+            // Ошибка во фрагменте параллельного разбора сообщается с номером строки файла
+            ostringstream program;
+            for (int i = 0; i < 120000; ++i)
+            {
+                program << "x" << i << " = " << i << "\n";
+            }
+            program << "z = 99999999999999999999\n";
+            const auto path = filesystem::temp_directory_path() / "mython_large_numbers.my"s;
+            ofstream(path) << program.str();
+            try
+            {
+                Lexer bad(path, LexerMode::Eager, 4);
+                ASSERT(false);
+            }
+            catch (const LexerError &e)
+            {
+                ASSERT_EQUAL(e.Line(), 120001u);
+                ASSERT_EQUAL(e.Column(), 5u);
+            }
+
+            // При ошибках в нескольких фрагментах сообщается первая по тексту, как при
+            // последовательном разборе, даже если фрагмент с ней закончил разбор последним
+            ostringstream several;
+            for (int i = 1; i <= 120000; ++i)
+            {
+                several << (i == 50000 || i == 60500 || i == 119990 ? "y = 99999999999999999999" : "x = 1") << "\n";
+            }
+            ofstream(path) << several.str();
+            for (size_t threads : {size_t(1), size_t(4)})
+            {
+                try
+                {
+                    Lexer bad(path, LexerMode::Eager, threads);
+                    ASSERT(false);
+                }
+                catch (const LexerError &e)
+                {
+                    ASSERT_EQUAL(e.Line(), 50000u);
+                }
+            }
+            filesystem::remove(path);
+        }
+        void TestIncrementalLexer()
+        {
+            IncrementalLexer lexer("class A:\n"
+                                   "  def f(self):\n"
+                                   "    if x:\n"
+                                   "      print 'deep'\n"
+                                   "\n"
+                                   "    return 1\n"
+                                   "a = A()\n"
+                                   "print a.f()\n"s);
+
+            auto check = [&lexer]
+            {
+                string text;
+                for (size_t i = 0; i < lexer.LineCount(); ++i)
+                {
+                    text += lexer.Line(i) + "\n"s;
+                }
+                istringstream input(text);
+                Lexer expected(input);
+                // Токены строк выдаются на месте, без копирования
+                for (const Token &token : lexer.Tokens())
+                {
+                    ASSERT_EQUAL(token, expected.CurrentToken());
+                    expected.NextToken();
+                }
+                ASSERT(expected.CurrentToken().Is<token_type::Eof>());
+                for (size_t i = 0; i < lexer.LineCount(); ++i)
+                {
+                    const auto &line = lexer.LineTokens(i);
+                    if (!line.empty())
+                    {
+                        const auto tokens = lexer.Tokens();
+                        ASSERT(std::ranges::find_if(tokens, [&](const Token &token)
+                                                    { return &token == &line.front(); }) != tokens.end());
+                    }
+                }
+            };
+            check();
+
+            // Смена отступа одной строки
+            lexer.Edit(3, 4, "    print 'shallow'"sv);
+            ASSERT_EQUAL(lexer.LastRelexedLines(), 1u);
+            check();
+            // Вставка вложенного блока с пустыми строками, комментарием и строкой из пробелов
+            lexer.Edit(5, 5, "    while_ = 2\n      \n   # note\n    if y:\n        z = 3\n\n"sv);
+            ASSERT_EQUAL(lexer.LastRelexedLines(), 6u);
+            check();
+            // Удаление строк, после которого последняя строка уходит на верхний уровень
+            lexer.Edit(1, 4, ""sv);
+            check();
+            lexer.Edit(lexer.LineCount() - 1, lexer.LineCount(), "        print a"sv);
+            check();
+            lexer.Edit(0, 0, "# header\n"sv);
+            check();
+            // Правки по обе стороны от разрыва буфера строк и вставки больше свободного места
+            for (size_t i = 0; i < 40; ++i)
+            {
+                const size_t line = i % 2 == 0 ? 1 : lexer.LineCount() - 1;
+                lexer.Edit(line, line, "x"s + to_string(i) + " = 1\ny = x\n"s);
+            }
+            check();
+            lexer.Edit(2, 60, "if x:\n  y = 1\n"sv);
+            check();
+            lexer.Edit(1, 1, string(200, '\n') + "z = 2\n"s);
+            ASSERT_EQUAL(lexer.LastRelexedLines(), 201u);
+            check();
+            lexer.Edit(1, 202, ""sv);
+            check();
+
+            // Ошибка разбора не меняет текст
+            const size_t lines = lexer.LineCount();
+            ASSERT_THROWS(lexer.Edit(0, 1, "x = 99999999999999999999\n"sv), LexerError);
+            ASSERT_EQUAL(lexer.LineCount(), lines);
+            ASSERT_EQUAL(lexer.Line(0), "# header"s);
+            check();
+
+            lexer.Edit(0, lexer.LineCount(), ""sv);
+            auto tokens = lexer.Tokens();
+            ASSERT_EQUAL(vector<Token>(tokens.begin(), tokens.end()), vector<Token>{Token(token_type::Eof{})});
+        }
+        void TestPeekToken()
+        {
+            const string program = "if x:\n  print y, 'z'\n"s;
+            for (auto mode : {LexerMode::Eager, LexerMode::Streaming})
+            {
+                istringstream input(program);
+                Lexer lexer(input, mode);
+
+                ASSERT_EQUAL(lexer.PeekToken(0), Token(token_type::If{}));
+                ASSERT_EQUAL(lexer.PeekToken(4), Token(token_type::Indent{}));
+                ASSERT_EQUAL(lexer.PeekToken(2), Token(token_type::Char{':'}));
+                ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::If{}));
+
+                ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"x"s}));
+                ASSERT_EQUAL(lexer.PeekToken(6), Token(token_type::Char{','}));
+                ASSERT_EQUAL(lexer.PeekToken(10), Token(token_type::Eof{}));
+                ASSERT_EQUAL(lexer.PeekToken(11), Token(token_type::Eof{}));
+                ASSERT_EQUAL(lexer.PeekToken(Lexer::MAX_LOOKAHEAD), Token(token_type::Eof{}));
+                ASSERT_THROWS(lexer.PeekToken(Lexer::MAX_LOOKAHEAD + 1), std::out_of_range);
+
+                ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{':'}));
+                ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+                ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Indent{}));
+                ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Print{}));
+            }
+        }
+        void TestTokenGenerator()
+        {
+            const string program = "class A:\n"
+                                   "  def f(self):\n"
+                                   "    return 'x' + \"y\" # comment\n"
+                                   "\n"
+                                   "print A().f(), 12 <= 3\n"s;
+            istringstream expected_input(program);
+            Lexer expected(expected_input);
+            istringstream input(program);
+            size_t count = 0;
+            for (Token &token : Lexer::Generate(input))
+            {
+                ASSERT_EQUAL(token, expected.CurrentToken());
+                expected.NextToken();
+                ++count;
+            }
+            ASSERT_EQUAL(count, 34u);
+
+            // Фильтр поверх генератора без промежуточного контейнера
+            auto ids = [](istream &in, shared_ptr<symbols::SymbolTable> symbols) -> Generator<Token>
+            {
+                for (Token &token : Lexer::Generate(in, std::move(symbols)))
+                {
+                    if (token.Is<token_type::Id>())
+                    {
+                        co_yield token;
+                    }
+                }
+            };
+            istringstream filter_input(program);
+            vector<Token> found;
+            // Токены переживают генератор, поэтому строки их Id хранит таблица теста
+            auto symbols = make_shared<symbols::SymbolTable>();
+            for (Token &token : ids(filter_input, symbols))
+            {
+                found.push_back(std::move(token));
+            }
+            ASSERT_EQUAL(found.size(), 5u);
+            ASSERT_EQUAL(found.back(), Token(token_type::Id{"f"s}));
+
+            // Ошибка разбора выбрасывается при продвижении к ошибочному токену
+            istringstream bad_input("x = 1\ny = 99999999999999999999\n"s);
+            auto tokens = Lexer::Generate(bad_input);
+            auto it = tokens.begin();
+            ASSERT_EQUAL(*it, Token(token_type::Id{"x"s}));
+            ++it;
+            ++it;
+            ++it;
+            ASSERT_EQUAL(*it, Token(token_type::Newline{}));
+            // Токены до ошибки в той же строке уже выданы
+            ++it;
+            ASSERT_EQUAL(*it, Token(token_type::Id{"y"s}));
+            ++it;
+            ASSERT_THROWS(++it, LexerError);
+        }
+        void TestTryExpect()
+        {
+            istringstream input("x = 'a'\n"s);
+            Lexer lexer(input);
+
+            auto id = lexer.TryExpect<token_type::Id>();
+            ASSERT(id);
+            ASSERT_EQUAL(id->value, "x"sv);
+            ASSERT(lexer.TryExpect<token_type::Id>("x"s));
+            ASSERT(!lexer.TryExpect<token_type::Id>("y"s));
+            ASSERT_EQUAL(lexer.TryExpect<token_type::Id>("y"s).error().message, "Wrong token value"s);
+
+            auto wrong = lexer.TryExpect<token_type::Number>();
+            ASSERT(!wrong);
+            ASSERT_THROWS(wrong.value(), LexerError);
+
+            // Неудачный TryExpectNext не сдвигает позицию
+            ASSERT(!lexer.TryExpectNext<token_type::Id>());
+            ASSERT(!lexer.TryExpectNext<token_type::Char>('+'));
+            ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Id{"x"s}));
+            ASSERT(lexer.TryExpectNext<token_type::Char>('='));
+            ASSERT_EQUAL(lexer.TryExpectNext<token_type::String>()->value, "a"sv);
+            ASSERT(lexer.TryExpectNext<token_type::Newline>());
+        }
+
+        void TestErrorCollection()
+        {
+            const string program = "x = 1\n"
+                                   "if x:\n"
+                                   "  y = x $ 2\n"
+                                   "  z = 99999999999999999999\n"
+                                   "  print y\n"
+                                   "w = 3 ? 4\n"
+                                   "print w\n"s;
+            // Ошибочные строки пропускаются целиком
+            const string valid = "x = 1\n"
+                                 "if x:\n"
+                                 "  print y\n"
+                                 "print w\n"s;
+
+            auto check = [&](Lexer &lexer)
+            {
+                istringstream expected_input(valid);
+                Lexer expected(expected_input);
+                ASSERT_EQUAL(lexer.CurrentToken(), expected.CurrentToken());
+                while (expected.CurrentToken() != Token(token_type::Eof{}))
+                {
+                    ASSERT_EQUAL(lexer.NextToken(), expected.NextToken());
+                }
+
+                const auto &errors = lexer.Errors();
+                ASSERT_EQUAL(errors.size(), 3u);
+                ASSERT_EQUAL(errors[0].line, 3u);
+                ASSERT_EQUAL(errors[0].column, 9u);
+                ASSERT_EQUAL(errors[0].message, "Unknown operator $"s);
+                ASSERT_EQUAL(errors[1].line, 4u);
+                ASSERT_EQUAL(errors[1].column, 7u);
+                ASSERT_EQUAL(errors[2].line, 6u);
+                ASSERT_EQUAL(errors[2].column, 7u);
+            };
+
+            for (auto mode : {LexerMode::Eager, LexerMode::Streaming, LexerMode::ZeroCopy})
+            {
+                istringstream input(program);
+                Lexer lexer(input, mode, ErrorPolicy::Collect);
+                check(lexer);
+            }
+
+            const auto path = filesystem::temp_directory_path() / "mython_error_collection.my"s;
+            ofstream(path) << program;
+            Lexer parallel(path, LexerMode::Eager, 4, ErrorPolicy::Collect);
+            check(parallel);
+            filesystem::remove(path);
+
+            istringstream input(program);
+            try
+            {
+                Lexer lexer(input);
+                ASSERT(false);
+            }
+            catch (const LexerError &e)
+            {
+                ASSERT_EQUAL(e.Line(), 3u);
+                ASSERT_EQUAL(e.Column(), 9u);
+            }
+        }
+        void TestLexerStats()
+        {
+            const string program = "class A:\n"
+                                   "  def f(self):\n"
+                                   "\n"
+                                   "    return 'a\\n' + 'b'\n"
+                                   "# comment\n"s;
+            istringstream input(program);
+            Lexer lexer(input);
+            const auto &stats = lexer.Stats();
+
+            if constexpr (LexerStats::ENABLED)
+            {
+                ASSERT_EQUAL(stats.lines, 5u);
+                ASSERT_EQUAL(stats.bytes, program.size());
+                ASSERT_EQUAL(stats.escape_decodes, 1u);
+                // A, f, self
+                ASSERT_EQUAL(stats.keyword_misses, 3u);
+                ASSERT_EQUAL(stats.tokens[TokenKind<token_type::String>()], 2u);
+                ASSERT_EQUAL(stats.tokens[TokenKind<token_type::Newline>()], 3u);
+                // Закрывающие Dedent и Eof дописывает Lexer, а не Tokenazer, но они тоже учитываются
+                ASSERT_EQUAL(stats.tokens[TokenKind<token_type::Dedent>()], 2u);
+                ASSERT_EQUAL(stats.tokens[TokenKind<token_type::Eof>()], 1u);
+                ASSERT_EQUAL(stats.TotalTokens(), 21u);
+            }
+            else
+            {
+                ASSERT_EQUAL(stats.lines, 0u);
+                ASSERT_EQUAL(stats.TotalTokens(), 0u);
+            }
+            ASSERT_EQUAL(TokenKindName(TokenKind<token_type::GreaterOrEq>()), "GreaterOrEq"s);
+            ASSERT_EQUAL(TokenKindName(TokenKind<token_type::BigNumber>()), "BigNumber"s);
+        }
+
+        void TestTokenLocations()
+        {
+            istringstream input("x = 1\n"
+                                "if x:\n"
+                                "  print 'a'\n"
+                                "# c\n"
+                                "y\n"s);
+            Lexer lexer(input);
+            auto check = [&](size_t index, uint32_t line, uint32_t column)
+            {
+                auto location = lexer.Location(index);
+                ASSERT(location);
+                ASSERT_EQUAL(location->line, line);
+                ASSERT_EQUAL(location->column, column);
+            };
+            check(0, 1, 1);
+            check(2, 1, 5);
+            check(3, 1, 6);   // Newline
+            check(8, 3, 3);   // Indent
+            check(10, 3, 9);  // 'a'
+            check(12, 5, 1);  // Dedent
+            check(15, 6, 1);  // Eof
+            ASSERT(!lexer.Location(16));
+
+            lexer.NextToken();
+            auto wrong = lexer.TryExpect<token_type::Number>();
+            ASSERT_EQUAL(wrong.error().line, 1u);
+            ASSERT_EQUAL(wrong.error().column, 3u);
+
+            // Позиции не зависят от режима и числа потоков; в Streaming они переживают освобождение токенов
+            string program;
+            for (int i = 0; program.size() < 600 * 1024; ++i)
+            {
+                program += "class C"s + to_string(i) + ":\n  def f(self):\n    return 'x' + \"y\"\n\n"s;
+            }
+            const auto path = filesystem::temp_directory_path() / "mython_token_locations.my"s;
+            ofstream(path) << program;
+            Lexer eager(path);
+            Lexer parallel(path, LexerMode::Eager, 4);
+            istringstream stream_input(program);
+            Lexer streaming(stream_input, LexerMode::Streaming);
+            for (size_t i = 0;; ++i, streaming.NextToken())
+            {
+                ASSERT(eager.Location(i) == parallel.Location(i));
+                ASSERT(eager.Location(i) == streaming.CurrentLocation());
+                if (streaming.CurrentToken().Is<token_type::Eof>())
+                {
+                    ASSERT(!eager.Location(i + 1));
+                    break;
+                }
+            }
+
+            // Комментарии с отступом меняют уровень, но не дают токенов. Почти все строки - такие
+            // комментарии, так что фрагменты параллельного разбора начинаются с них
+            string comments;
+            for (int i = 0; comments.size() < 1200 * 1024; ++i)
+            {
+                comments += "class C"s + to_string(i) + ":\n  x = 1\n"s;
+                for (int line = 0; line < 30; ++line)
+                {
+                    comments += line % 2 ? "   # c\n"s : "     # c\n"s;
+                }
+            }
+            ofstream(path) << comments;
+            Lexer serial(path);
+            Lexer chunked(path, LexerMode::Eager, 4);
+            for (size_t i = 0; serial.Location(i); ++i)
+            {
+                ASSERT(serial.Location(i) == chunked.Location(i));
+            }
+            filesystem::remove(path);
+        }
+
+        void TestEscapedStrings()
+        {
+            // Длинный текст с escape-последовательностями по обе стороны границ блоков сканера
+            string blob_source;
+            string blob;
+            for (int i = 0; i < 100; ++i)
+            {
+                blob_source += "line "s + to_string(i) + "\\n\\t\\\"q\\\" "s + string(i % 37, 'x');
+                blob += "line "s + to_string(i) + "\n\t\"q\" "s + string(i % 37, 'x');
+            }
+            const string program = R"(s = '\a\b' + "\\" + 'end\'' + "\x" + 'tail\)"s + "\nb = \""s + blob_source +
+                                   "\"\n"s;
+
+            for (auto mode : {LexerMode::Eager, LexerMode::ZeroCopy})
+            {
+                istringstream input(program);
+                Lexer lexer(input, mode);
+                ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
+                ASSERT_EQUAL(lexer.NextToken(), Token(token_type::String{"\\a\\b"s}));
+                lexer.NextToken();
+                ASSERT_EQUAL(lexer.NextToken(), Token(token_type::String{"\\"s}));
+                lexer.NextToken();
+                ASSERT_EQUAL(lexer.NextToken(), Token(token_type::String{"end'"s}));
+                lexer.NextToken();
+                ASSERT_EQUAL(lexer.NextToken(), Token(token_type::String{"\\x"s}));
+                lexer.NextToken();
+                // Незакрытая строка заканчивается вместе со строкой источника
+                ASSERT_EQUAL(lexer.NextToken(), Token(token_type::String{"tail\\"s}));
+                ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+                lexer.NextToken();
+                lexer.NextToken();
+                ASSERT_EQUAL(lexer.NextToken(), Token(token_type::String{blob}));
+                ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+            }
+        }
     } // namespace
 
     void RunOpenLexerTests(TestRunner &tr)
@@ -390,6 +1460,31 @@ abc#
         RUN_TEST(tr, parse::TestMythonProgram);
         RUN_TEST(tr, parse::TestAlwaysEmitsNewlineAtTheEndOfNonemptyLine);
         RUN_TEST(tr, parse::TestCommentsAreIgnored);
+        RUN_TEST(tr, parse::TestStreamingMode);
+        RUN_TEST(tr, parse::TestFileInput);
+        RUN_TEST(tr, parse::TestZeroCopyMode);
+        RUN_TEST(tr, parse::TestIdsAreInterned);
+        RUN_TEST(tr, parse::TestCharScanKernels);
+        RUN_TEST(tr, parse::TestCarriageReturnIsWhitespace);
+        RUN_TEST(tr, parse::TestLexersKeepOwnIndentation);
+        RUN_TEST(tr, parse::TestLexFiles);
+        RUN_TEST(tr, parse::TestParallelFileLexing);
+        RUN_TEST(tr, parse::TestTokenStream);
+        RUN_TEST(tr, parse::TestTokenCache);
+        RUN_TEST(tr, parse::TestLineReader);
+        RUN_TEST(tr, parse::TestLargeNumbers);
+        RUN_TEST(tr, parse::TestIncrementalLexer);
+        RUN_TEST(tr, parse::TestPeekToken);
+        RUN_TEST(tr, parse::TestTokenGenerator);
+        RUN_TEST(tr, parse::TestTryExpect);
+        RUN_TEST(tr, parse::TestErrorCollection);
+        RUN_TEST(tr, parse::TestLexerStats);
+        RUN_TEST(tr, parse::TestTokenLocations);
+        RUN_TEST(tr, parse::TestEscapedStrings);
+        RUN_TEST(tr, parse::TestUtf8Validation);
+        RUN_TEST(tr, parse::TestUnicodeIdentifiers);
+        RUN_TEST(tr, parse::TestTokenRelease);
+        RUN_TEST(tr, parse::TestStreamingReferencesStayValid);
     }
 
 } // namespace parse
\ No newline at end of file
@@ -0,0 +1,269 @@
+#include "bench_util.h"
+#include "char_scan.h"
+#include "lexer.h"
+#include "program_generator.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+    const char USAGE[] = "Usage: lexer_throughput [--size MB] [--shape NAME] [--repeat N] [--isa NAME]\n"
+                         "                        [--save FILE] [--baseline FILE] [--tolerance PERCENT]\n"
+                         "Shapes: mixed, deep-indent, long-strings, identifiers, comments, cyrillic\n"
+                         "ISA: scalar, sse2, avx2 (default: the scanner's own choice)\n";
+
+    struct Options
+    {
+        double size_mb = 4;
+        vector<bench::Shape> shapes{begin(bench::ALL_SHAPES), end(bench::ALL_SHAPES)};
+        int repeat = 3;
+        string save;
+        string baseline;
+        double tolerance = 10;
+    };
+
+    struct Result
+    {
+        double mb_per_second = 0;
+        double mtokens_per_second = 0;
+        double allocs_per_token = 0;
+    };
+
+    // Ключ результата - "форма режим"
+    using Results = map<string, Result>;
+
+    const pair<parse::LexerMode, const char *> MODES[] = {{parse::LexerMode::Eager, "eager"},
+                                                          {parse::LexerMode::ZeroCopy, "zero-copy"},
+                                                          {parse::LexerMode::Streaming, "streaming"}};
+
+    // Лучшее из repeat измерений разбора program с проходом по всем токенам.
+    // Первый прогон не учитывается: он прогревает кэши процессора и распределитель памяти
+    Result Measure(const string &program, parse::LexerMode mode, int repeat)
+    {
+        size_t tokens = 0;
+        bench::Measure best;
+        for (int i = -1; i < repeat; ++i)
+        {
+            auto m = bench::Run([&]
+                                {
+                                    tokens = 1;
+                                    istringstream input(program);
+                                    parse::Lexer lexer(input, mode);
+                                    for (; !lexer.CurrentToken().Is<parse::token_type::Eof>(); lexer.NextToken())
+                                    {
+                                        ++tokens;
+                                    } });
+            if (i == 0 || m.seconds < best.seconds)
+            {
+                best = m;
+            }
+        }
+        return {program.size() / best.seconds / (1 << 20), tokens / best.seconds / 1e6,
+                static_cast<double>(best.allocations) / tokens};
+    }
+
+    optional<parse::scan::Isa> ParseIsa(const string &name)
+    {
+        for (auto isa : {parse::scan::Isa::Scalar, parse::scan::Isa::Sse2, parse::scan::Isa::Avx2})
+        {
+            if (name == parse::scan::IsaName(isa))
+            {
+                return isa;
+            }
+        }
+        return nullopt;
+    }
+
+    bool ParseOptions(int argc, char *argv[], Options &options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const string arg = argv[i];
+            if (i + 1 == argc)
+            {
+                return false;
+            }
+            const string value = argv[++i];
+            if (arg == "--size")
+            {
+                options.size_mb = stod(value);
+            }
+            else if (arg == "--shape")
+            {
+                auto shape = bench::ParseShape(value);
+                if (!shape)
+                {
+                    return false;
+                }
+                options.shapes = {*shape};
+            }
+            else if (arg == "--repeat")
+            {
+                options.repeat = max(1, stoi(value));
+            }
+            else if (arg == "--isa")
+            {
+                const auto isa = ParseIsa(value);
+                if (!isa)
+                {
+                    return false;
+                }
+                parse::scan::SetIsa(*isa);
+            }
+            else if (arg == "--save")
+            {
+                options.save = value;
+            }
+            else if (arg == "--baseline")
+            {
+                options.baseline = value;
+            }
+            else if (arg == "--tolerance")
+            {
+                options.tolerance = stod(value);
+            }
+            else
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Формат файла: по строке "форма режим MB/s Mtokens/s allocs/token" на результат.
+    // Сравнивать имеет смысл результаты, полученные с одинаковым --size
+    void SaveResults(const string &path, const Results &results)
+    {
+        ofstream out(path);
+        out << setprecision(10);
+        for (const auto &[key, result] : results)
+        {
+            out << key << ' ' << result.mb_per_second << ' ' << result.mtokens_per_second << ' '
+                << result.allocs_per_token << '\n';
+        }
+    }
+
+    Results LoadResults(const string &path)
+    {
+        Results results;
+        ifstream in(path);
+        string shape, mode;
+        Result result;
+        while (in >> shape >> mode >> result.mb_per_second >> result.mtokens_per_second >> result.allocs_per_token)
+        {
+            results[shape + ' ' + mode] = result;
+        }
+        return results;
+    }
+
+    // Печатает отклонения от базовых результатов. Регрессия - падение скорости или рост
+    // числа выделений на токен больше чем на tolerance процентов. Возвращает число регрессий
+    int CompareResults(const Results &results, const Results &baseline, double tolerance)
+    {
+        // Доля выделений на токен бывает почти нулевой, поэтому рост до этого порога не считается
+        constexpr double ALLOCS_EPSILON = 1e-3;
+        const double factor = tolerance / 100;
+
+        int regressions = 0;
+        cout << "\nAgainst baseline (tolerance " << tolerance << "%):\n";
+        for (const auto &[key, result] : results)
+        {
+            auto it = baseline.find(key);
+            if (it == baseline.end())
+            {
+                cout << setw(24) << left << key << "no baseline\n";
+                continue;
+            }
+            const Result &base = it->second;
+            const double speed = (result.mtokens_per_second / base.mtokens_per_second - 1) * 100;
+            const bool slower = result.mtokens_per_second < base.mtokens_per_second * (1 - factor);
+            const bool more_allocs = result.allocs_per_token > base.allocs_per_token * (1 + factor) + ALLOCS_EPSILON;
+            regressions += slower || more_allocs;
+
+            cout << setw(24) << left << key << right << showpos << fixed << setprecision(1) << speed << "% tokens/s"
+                 << noshowpos << ", allocs/token " << setprecision(4) << base.allocs_per_token << " -> "
+                 << result.allocs_per_token << (slower || more_allocs ? "  REGRESSION" : "") << '\n';
+        }
+        cout << defaultfloat;
+        return regressions;
+    }
+
+    // В режиме ZeroCopy строки и имена Id ссылаются на вход и таблицу символов, поэтому
+    // программа из одних идентификаторов почти не выделяет памяти. Возвращает false при нарушении
+    bool CheckZeroCopyIdentifiers(const Results &results)
+    {
+        constexpr double MAX_ALLOCS_PER_TOKEN = 0.01;
+        auto it = results.find("identifiers zero-copy");
+        if (it == results.end() || it->second.allocs_per_token <= MAX_ALLOCS_PER_TOKEN)
+        {
+            return true;
+        }
+        cout << "identifiers zero-copy: " << it->second.allocs_per_token << " allocs/token, expected at most "
+             << MAX_ALLOCS_PER_TOKEN << "  REGRESSION\n";
+        return false;
+    }
+} // namespace
+
+// Сравнивает пропускную способность лексера на синтетических программах разной формы.
+// Результаты можно сохранить (--save) и сравнить с сохранёнными ранее (--baseline):
+// при регрессии, как и при выделениях памяти на идентификаторах в режиме ZeroCopy,
+// программа завершается с кодом 1
+int main(int argc, char *argv[])
+{
+    Options options;
+    try
+    {
+        if (!ParseOptions(argc, argv, options))
+        {
+            cerr << USAGE;
+            return 2;
+        }
+    }
+    catch (const logic_error &)
+    {
+        cerr << USAGE;
+        return 2;
+    }
+
+    Results results;
+    cout << setw(24) << left << "shape mode" << right << setw(10) << "MB/s" << setw(12) << "Mtokens/s" << setw(14)
+         << "allocs/token" << '\n';
+    for (bench::Shape shape : options.shapes)
+    {
+        bench::GeneratorOptions generator;
+        generator.shape = shape;
+        generator.size = static_cast<size_t>(options.size_mb * (1 << 20));
+        const string program = bench::GenerateProgram(generator);
+
+        for (const auto &[mode, mode_name] : MODES)
+        {
+            const string key = string(bench::ShapeName(shape)) + ' ' + mode_name;
+            const Result result = Measure(program, mode, options.repeat);
+            results[key] = result;
+            cout << setw(24) << left << key << right << fixed << setprecision(2) << setw(10) << result.mb_per_second
+                 << setw(12) << result.mtokens_per_second << setprecision(5) << setw(14) << result.allocs_per_token
+                 << defaultfloat << endl;
+        }
+    }
+
+    if (!options.save.empty())
+    {
+        SaveResults(options.save, results);
+    }
+    bool ok = CheckZeroCopyIdentifiers(results);
+    if (!options.baseline.empty())
+    {
+        ok = CompareResults(results, LoadResults(options.baseline), options.tolerance) == 0 && ok;
+    }
+    return ok ? 0 : 1;
+}
@@ -1,17 +1,55 @@
 #include "lexer.h"
 #include "test_runner_p.h"
 
+#include <filesystem>
 #include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std::literals;
 
 namespace parse
 {
     void RunOpenLexerTests(TestRunner &tr);
 }
 
-int main()
+namespace
+{
+    // --lexer-stats [files...]: разбирает файлы (или std::cin) и печатает статистику лексера
+    int PrintLexerStats(const std::vector<std::string> &files)
+    {
+        if (!parse::LexerStats::ENABLED)
+        {
+            std::cerr << "Lexer statistics are disabled, rebuild with -DMYTHON_LEXER_STATS=ON" << std::endl;
+            return 1;
+        }
+
+        if (files.empty())
+        {
+            parse::Lexer lexer(std::cin);
+            std::cout << lexer.Stats();
+            return 0;
+        }
+
+        for (const auto &file : files)
+        {
+            parse::Lexer lexer{std::filesystem::path(file)};
+            std::cout << file << ":\n"
+                      << lexer.Stats();
+        }
+        return 0;
+    }
+} // namespace
+
+int main(int argc, char *argv[])
 {
     try
     {
+        if (argc > 1 && argv[1] == "--lexer-stats"s)
+        {
+            return PrintLexerStats({argv + 2, argv + argc});
+        }
+
         TestRunner tr;
         parse::RunOpenLexerTests(tr);
         // parse::Lexer lexer(std::cin);
@@ -27,4 +65,4 @@ int main()
         std::cerr << e.what();
         return 1;
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,209 @@
+#include "program_generator.h"
+
+#include <algorithm>
+#include <iterator>
+#include <random>
+
+namespace bench
+{
+
+    namespace
+    {
+        constexpr std::string_view SHAPE_NAMES[] = {"mixed", "deep-indent", "long-strings", "identifiers", "comments",
+                                                  "cyrillic"};
+
+        constexpr std::string_view WORDS[] = {"alpha", "beta", "gamma", "delta", "value", "count", "index",
+                                              "node", "left", "right", "parent", "buffer", "result", "total",
+                                              "width", "height", "name", "item", "cursor", "offset"};
+
+        constexpr std::string_view CYRILLIC_WORDS[] = {"счёт", "итог", "узел", "левый", "правый", "буфер",
+                                                       "ширина", "высота", "имя", "элемент", "курсор", "сдвиг"};
+
+        class Writer
+        {
+        public:
+            explicit Writer(const GeneratorOptions &options) : options_(options), random_(options.seed) {}
+
+            bool Full() const
+            {
+                return out_.size() >= options_.size;
+            }
+
+            std::string Take()
+            {
+                return std::move(out_);
+            }
+
+            size_t Random(size_t bound)
+            {
+                return std::uniform_int_distribution<size_t>(0, bound - 1)(random_);
+            }
+
+            // Идентификатор из одного-трёх слов словаря с числовым суффиксом
+            std::string Identifier()
+            {
+                std::string id(WORDS[Random(std::size(WORDS))]);
+                for (size_t parts = Random(3); parts > 0; --parts)
+                {
+                    id += '_';
+                    id += WORDS[Random(std::size(WORDS))];
+                }
+                id += std::to_string(Random(100));
+                return id;
+            }
+
+            std::string CyrillicIdentifier()
+            {
+                std::string id(CYRILLIC_WORDS[Random(std::size(CYRILLIC_WORDS))]);
+                if (Random(2))
+                {
+                    id += '_';
+                    id += CYRILLIC_WORDS[Random(std::size(CYRILLIC_WORDS))];
+                }
+                return id;
+            }
+
+            void Line(size_t depth, std::string_view text)
+            {
+                out_.append(depth * 2, ' ');
+                out_ += text;
+                out_ += '\n';
+            }
+
+            void Mixed(size_t block)
+            {
+                const std::string i = std::to_string(block);
+                Line(0, "class Point" + i + ":");
+                Line(1, "def __init__(self, x, y):");
+                Line(2, "self.x = x");
+                Line(2, "self.y = y");
+                out_ += '\n';
+                Line(1, "def __str__(self):");
+                Line(2, "if self.x >= " + i + " and not self.y == None:");
+                Line(3, "return str(self.x) + ' ' + str(self.y) # comment");
+                Line(2, "else:");
+                Line(3, "return \"point \\\"" + i + "\\\"\"");
+                Line(0, "p" + i + " = Point" + i + "(1, 2)");
+                Line(0, "print str(p" + i + ")");
+            }
+
+            void DeepIndent()
+            {
+                const size_t depth = 1 + Random(options_.max_depth);
+                for (size_t level = 0; level < depth; ++level)
+                {
+                    Line(level, "if x" + std::to_string(level) + " > " + std::to_string(Random(1000)) + ":");
+                }
+                // Выход сразу на несколько уровней даёт серии Dedent
+                for (size_t level = depth; level > 0; level -= std::min(level, 1 + Random(4)))
+                {
+                    Line(level, "y = y + " + std::to_string(level));
+                }
+                Line(0, "print y");
+            }
+
+            void LongStrings()
+            {
+                static constexpr std::string_view ESCAPES[] = {"\\n", "\\t", "\\\"", "\\'", "\\\\"};
+                const char quote = Random(2) ? '"' : '\'';
+                std::string literal(1, quote);
+                const size_t length = options_.string_length / 2 + Random(options_.string_length + 1);
+                while (literal.size() < length)
+                {
+                    if (Random(8) == 0)
+                    {
+                        literal += ESCAPES[Random(std::size(ESCAPES))];
+                    }
+                    else
+                    {
+                        literal += static_cast<char>('a' + Random(26));
+                    }
+                }
+                literal += quote;
+                Line(0, Identifier() + " = " + literal);
+            }
+
+            void Identifiers()
+            {
+                std::string line = Identifier() + " = " + Identifier();
+                for (size_t terms = 1 + Random(4); terms > 0; --terms)
+                {
+                    line += Random(2) ? " + " : " * ";
+                    line += Identifier() + '.' + Identifier() + '(' + Identifier() + ", " + Identifier() + ')';
+                }
+                Line(0, line);
+            }
+
+            void Comments()
+            {
+                for (size_t lines = 1 + Random(4); lines > 0; --lines)
+                {
+                    Line(Random(2), "# " + Identifier() + " " + Identifier() + " " + Identifier() + " " + Identifier());
+                }
+                Line(0, Identifier() + " = " + std::to_string(Random(1000)) + "  # " + Identifier());
+            }
+
+            void Cyrillic()
+            {
+                const std::string name = CyrillicIdentifier();
+                Line(0, "# " + CyrillicIdentifier() + " и " + CyrillicIdentifier());
+                Line(0, "if " + name + " > " + std::to_string(Random(1000)) + ":");
+                Line(1, name + " = " + CyrillicIdentifier() + " + " + CyrillicIdentifier() + " * 2");
+                Line(1, "print 'Значение " + CyrillicIdentifier() + ":', " + name);
+            }
+
+        private:
+            const GeneratorOptions &options_;
+            std::mt19937 random_;
+            std::string out_;
+        };
+    } // namespace
+
+    std::string_view ShapeName(Shape shape)
+    {
+        return SHAPE_NAMES[static_cast<size_t>(shape)];
+    }
+
+    std::optional<Shape> ParseShape(std::string_view name)
+    {
+        for (Shape shape : ALL_SHAPES)
+        {
+            if (ShapeName(shape) == name)
+            {
+                return shape;
+            }
+        }
+        return std::nullopt;
+    }
+
+    std::string GenerateProgram(const GeneratorOptions &options)
+    {
+        Writer writer(options);
+        for (size_t block = 0; !writer.Full(); ++block)
+        {
+            switch (options.shape)
+            {
+            case Shape::Mixed:
+                writer.Mixed(block);
+                break;
+            case Shape::DeepIndent:
+                writer.DeepIndent();
+                break;
+            case Shape::LongStrings:
+                writer.LongStrings();
+                break;
+            case Shape::Identifiers:
+                writer.Identifiers();
+                break;
+            case Shape::Comments:
+                writer.Comments();
+                break;
+            case Shape::Cyrillic:
+                writer.Cyrillic();
+                break;
+            }
+        }
+        return writer.Take();
+    }
+
+} // namespace bench
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace bench
+{
+
+    // Форма синтетической программы на Mython
+    enum class Shape
+    {
+        // Классы с методами, условиями, строками и комментариями вперемешку
+        Mixed,
+        // Глубоко вложенные блоки: много Indent/Dedent и коротких строк
+        DeepIndent,
+        // Длинные строковые литералы с escape-последовательностями
+        LongStrings,
+        // Выражения из длинных идентификаторов, почти без ключевых слов
+        Identifiers,
+        // Строки комментариев и комментарии в конце строк кода
+        Comments,
+        // Идентификаторы, строки и комментарии на кириллице
+        Cyrillic,
+    };
+
+    inline constexpr Shape ALL_SHAPES[] = {Shape::Mixed, Shape::DeepIndent, Shape::LongStrings, Shape::Identifiers,
+                                           Shape::Comments, Shape::Cyrillic};
+
+    std::string_view ShapeName(Shape shape);
+    std::optional<Shape> ParseShape(std::string_view name);
+
+    struct GeneratorOptions
+    {
+        Shape shape = Shape::Mixed;
+        // Программа дописывается целыми фрагментами, пока не превысит size байт
+        size_t size = 1 << 20;
+        // Одинаковые параметры дают одинаковую программу
+        uint32_t seed = 1;
+        // Наибольшая вложенность для DeepIndent
+        size_t max_depth = 32;
+        // Средняя длина литерала для LongStrings
+        size_t string_length = 256;
+    };
+
+    // Синтаксически корректная для лексера программа заданной формы
+    std::string GenerateProgram(const GeneratorOptions &options);
+
+} // namespace bench
@@ -1,6 +1,8 @@
 #include "runtime.h"
 
 #include <cassert>
+#include <functional>
+#include <new>
 #include <optional>
 #include <sstream>
 
@@ -9,20 +11,106 @@ using namespace std;
 namespace runtime
 {
 
-    ObjectHolder::ObjectHolder(std::shared_ptr<Object> data)
-        : data_(std::move(data))
+    namespace
     {
+        thread_local symbols::SymbolTable *current_symbols = nullptr;
+    } // namespace
+
+    symbols::SymbolTable &Symbols()
+    {
+        if (current_symbols)
+        {
+            return *current_symbols;
+        }
+        thread_local symbols::SymbolTable thread_symbols;
+        return thread_symbols;
+    }
+
+    SymbolScope::SymbolScope(std::shared_ptr<symbols::SymbolTable> symbols)
+        : symbols_(std::move(symbols)), previous_(current_symbols)
+    {
+        current_symbols = symbols_.get();
+    }
+
+    SymbolScope::~SymbolScope()
+    {
+        current_symbols = previous_;
+    }
+
+    namespace
+    {
+        // Свободная память под Number текущего потока: односвязный список, звенья которого
+        // лежат в самих блоках. Объём пула ограничен, лишние блоки возвращаются в кучу.
+        // Переменные пула тривиально разрушаемы и доступны до самого завершения потока,
+        // даже из деструкторов других thread_local и статических объектов
+        struct FreeNumber
+        {
+            FreeNumber *next;
+        };
+
+        static_assert(sizeof(FreeNumber) <= sizeof(Number));
+
+        constexpr size_t MAX_FREE_NUMBERS = 4096;
+
+        thread_local FreeNumber *free_numbers = nullptr;
+        thread_local size_t free_number_count = 0;
+        // После освобождения пула память Number сразу возвращается в кучу
+        thread_local bool number_pool_closed = false;
+
+        // Возвращает блоки пула в кучу при завершении потока. Регистрируется при первом
+        // возврате блока в пул
+        struct NumberPoolCleanup
+        {
+            ~NumberPoolCleanup()
+            {
+                while (free_numbers)
+                {
+                    ::operator delete(std::exchange(free_numbers, free_numbers->next));
+                }
+                free_number_count = 0;
+                number_pool_closed = true;
+            }
+        };
+
+        thread_local NumberPoolCleanup number_pool_cleanup;
+    } // namespace
+
+    constinit Bool ObjectHolder::true_value_{true};
+    constinit Bool ObjectHolder::false_value_{false};
+
+    Number *ObjectHolder::NewNumber(int value)
+    {
+        void *memory = free_numbers;
+        if (memory)
+        {
+            free_numbers = free_numbers->next;
+            --free_number_count;
+        }
+        else
+        {
+            memory = ::operator new(sizeof(Number));
+        }
+        return new (memory) Number(value);
     }
 
-    void ObjectHolder::AssertIsValid() const
+    void ObjectHolder::DeleteNumber(Number *number) noexcept
     {
-        assert(data_ != nullptr);
+        number->~Number();
+        if (number_pool_closed || free_number_count == MAX_FREE_NUMBERS)
+        {
+            ::operator delete(number);
+            return;
+        }
+        // Обращение создаёт number_pool_cleanup и регистрирует его деструктор
+        [[maybe_unused]] const NumberPoolCleanup &cleanup = number_pool_cleanup;
+        free_numbers = new (number) FreeNumber{free_numbers};
+        ++free_number_count;
     }
 
     ObjectHolder ObjectHolder::Share(Object &object)
     {
-        // Возвращаем невладеющий shared_ptr (его deleter ничего не делает)
-        return ObjectHolder(std::shared_ptr<Object>(&object, [](auto * /*p*/) { /* do nothing */ }));
+        // Счётчик ссылок объекта не меняется
+        return ObjectHolder(&object, Kind::Shared);
     }
 
     ObjectHolder ObjectHolder::None()
@@ -32,88 +120,135 @@ namespace runtime
 
     Object &ObjectHolder::operator*() const
     {
-        AssertIsValid();
+        assert(*this);
         return *Get();
     }
 
     Object *ObjectHolder::operator->() const
     {
-        AssertIsValid();
+        assert(*this);
         return Get();
     }
 
-    Object *ObjectHolder::Get() const
+    ObjectHolder &Closure::at(std::string_view name)
     {
-        return data_.get();
+        auto it = find(name);
+        if (it == end())
+        {
+            throw std::out_of_range("Unknown name "s + std::string(name));
+        }
+        return it->second;
     }
 
-    ObjectHolder::operator bool() const
+    const ObjectHolder &Closure::at(std::string_view name) const
     {
-        return Get() != nullptr;
+        auto it = find(name);
+        if (it == end())
+        {
+            throw std::out_of_range("Unknown name "s + std::string(name));
+        }
+        return it->second;
     }
 
-    bool IsTrue(const ObjectHolder & /*object*/)
+    bool IsTrue(const ObjectHolder &object)
     {
-        // Заглушка. Реализуйте метод самостоятельно
+        if (const auto *number = object.TryAs<Number>())
+        {
+            return number->GetValue() != 0;
+        }
+        if (const auto *boolean = object.TryAs<Bool>())
+        {
+            return boolean->GetValue();
+        }
+        if (const auto *str = object.TryAs<String>())
+        {
+            return !str->GetValue().empty();
+        }
         return false;
     }
 
-    void ClassInstance::Print(std::ostream & /*os*/, Context & /*context*/)
+    void ClassInstance::Print(std::ostream &os, Context &context)
     {
-        // Заглушка, реализуйте метод самостоятельно
+        if (HasMethod("__str__"s, 0))
+        {
+            Call("__str__"s, {}, context)->Print(os, context);
+        }
+        else
+        {
+            os << this;
+        }
     }
 
-    bool ClassInstance::HasMethod(const std::string & /*method*/, size_t /*argument_count*/) const
+    bool ClassInstance::HasMethod(const std::string &method, size_t argument_count) const
     {
-        // Заглушка, реализуйте метод самостоятельно
-        return false;
+        const Method *found = cls_.GetMethod(method);
+        return found != nullptr && found->formal_params.size() == argument_count;
     }
 
     Closure &ClassInstance::Fields()
     {
-        // Заглушка. Реализуйте метод самостоятельно
-        throw std::logic_error("Not implemented"s);
+        return fields_;
     }
 
     const Closure &ClassInstance::Fields() const
     {
-        // Заглушка. Реализуйте метод самостоятельно
-        throw std::logic_error("Not implemented"s);
+        return fields_;
     }
 
-    ClassInstance::ClassInstance(const Class & /*cls*/)
+    ClassInstance::ClassInstance(const Class &cls)
+        : cls_(cls)
     {
-        // Реализуйте метод самостоятельно
     }
 
-    ObjectHolder ClassInstance::Call(const std::string & /*method*/,
-                                     const std::vector<ObjectHolder> & /*actual_args*/,
-                                     Context & /*context*/)
+    ObjectHolder ClassInstance::Call(const std::string &method,
+                                     const std::vector<ObjectHolder> &actual_args,
+                                     Context &context)
     {
-        // Заглушка. Реализуйте метод самостоятельно.
-        throw std::runtime_error("Not implemented"s);
+        const Method *found = cls_.GetMethod(method);
+        if (found == nullptr || found->formal_params.size() != actual_args.size())
+        {
+            throw std::runtime_error("Class "s + cls_.GetName() + " has no method "s + method + " with "s +
+                                     std::to_string(actual_args.size()) + " arguments"s);
+        }
+
+        Closure closure;
+        closure["self"sv] = ObjectHolder::Share(*this);
+        for (size_t i = 0; i < actual_args.size(); ++i)
+        {
+            closure[found->formal_params[i]] = actual_args[i];
+        }
+        return found->body->Execute(closure, context);
     }
 
-    Class::Class(std::string /*name*/, std::vector<Method> /*methods*/, const Class * /*parent*/)
+    Class::Class(std::string name, std::vector<Method> methods, const Class *parent)
+        : name_(std::move(name)), methods_(std::move(methods)), parent_(parent)
     {
-        // Реализуйте метод самостоятельно
     }
 
-    const Method *Class::GetMethod(const std::string & /*name*/) const
+    const Method *Class::GetMethod(const std::string &name) const
     {
-        // Заглушка. Реализуйте метод самостоятельно
+        // Метод потомка перекрывает одноимённый метод родителя
+        for (const Class *cls = this; cls != nullptr; cls = cls->parent_)
+        {
+            for (const Method &method : cls->methods_)
+            {
+                if (method.name == name)
+                {
+                    return &method;
+                }
+            }
+        }
         return nullptr;
     }
 
-    [[nodiscard]] inline const std::string &Class::GetName() const
+    const std::string &Class::GetName() const
     {
-        // Заглушка. Реализуйте метод самостоятельно.
-        throw std::runtime_error("Not implemented"s);
+        return name_;
     }
 
-    void Class::Print(ostream & /*os*/, Context & /*context*/)
+    void Class::Print(ostream &os, [[maybe_unused]] Context &context)
     {
-        // Заглушка. Реализуйте метод самостоятельно
+        os << "Class "sv << name_;
     }
 
     void Bool::Print(std::ostream &os, [[maybe_unused]] Context &context)
@@ -121,40 +256,92 @@ namespace runtime
         os << (GetValue() ? "True"sv : "False"sv);
     }
 
-    bool Equal(const ObjectHolder & /*lhs*/, const ObjectHolder & /*rhs*/, Context & /*context*/)
+    namespace
     {
-        // Заглушка. Реализуйте функцию самостоятельно
+        // Сравнивает однотипные Number, Bool и String. Number и Bool, созданные через
+        // ObjectHolder::Own, проверяются TryAs без dynamic_cast, поэтому числа сравниваются первыми
+        template <typename Compare>
+        std::optional<bool> CompareValues(const ObjectHolder &lhs, const ObjectHolder &rhs, Compare compare)
+        {
+            if (const auto *l = lhs.TryAs<Number>())
+            {
+                const auto *r = rhs.TryAs<Number>();
+                return r ? std::optional(compare(l->GetValue(), r->GetValue())) : std::nullopt;
+            }
+            if (const auto *l = lhs.TryAs<Bool>())
+            {
+                const auto *r = rhs.TryAs<Bool>();
+                return r ? std::optional(compare(l->GetValue(), r->GetValue())) : std::nullopt;
+            }
+            if (const auto *l = lhs.TryAs<String>())
+            {
+                const auto *r = rhs.TryAs<String>();
+                return r ? std::optional(compare(l->GetValue(), r->GetValue())) : std::nullopt;
+            }
+            return std::nullopt;
+        }
+
+        // Вызывает у lhs метод method с аргументом rhs, если он есть
+        std::optional<bool> CallCompareMethod(const ObjectHolder &lhs, const ObjectHolder &rhs,
+                                              const std::string &method, Context &context)
+        {
+            auto *instance = lhs.TryAs<ClassInstance>();
+            if (instance == nullptr || !instance->HasMethod(method, 1))
+            {
+                return std::nullopt;
+            }
+            return IsTrue(instance->Call(method, {rhs}, context));
+        }
+    } // namespace
+
+    bool Equal(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context)
+    {
+        if (!lhs && !rhs)
+        {
+            return true;
+        }
+        if (auto result = CompareValues(lhs, rhs, std::equal_to<>()))
+        {
+            return *result;
+        }
+        if (auto result = CallCompareMethod(lhs, rhs, "__eq__"s, context))
+        {
+            return *result;
+        }
         throw std::runtime_error("Cannot compare objects for equality"s);
     }
 
-    bool Less(const ObjectHolder & /*lhs*/, const ObjectHolder & /*rhs*/, Context & /*context*/)
+    bool Less(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context)
     {
-        // Заглушка. Реализуйте функцию самостоятельно
+        if (auto result = CompareValues(lhs, rhs, std::less<>()))
+        {
+            return *result;
+        }
+        if (auto result = CallCompareMethod(lhs, rhs, "__lt__"s, context))
+        {
+            return *result;
+        }
         throw std::runtime_error("Cannot compare objects for less"s);
     }
 
-    bool NotEqual(const ObjectHolder & /*lhs*/, const ObjectHolder & /*rhs*/, Context & /*context*/)
+    bool NotEqual(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context)
     {
-        // Заглушка. Реализуйте функцию самостоятельно
-        throw std::runtime_error("Cannot compare objects for equality"s);
+        return !Equal(lhs, rhs, context);
     }
 
-    bool Greater(const ObjectHolder & /*lhs*/, const ObjectHolder & /*rhs*/, Context & /*context*/)
+    bool Greater(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context)
     {
-        // Заглушка. Реализуйте функцию самостоятельно
-        throw std::runtime_error("Cannot compare objects for equality"s);
+        return !Less(lhs, rhs, context) && !Equal(lhs, rhs, context);
     }
 
-    bool LessOrEqual(const ObjectHolder & /*lhs*/, const ObjectHolder & /*rhs*/, Context & /*context*/)
+    bool LessOrEqual(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context)
     {
-        // Заглушка. Реализуйте функцию самостоятельно
-        throw std::runtime_error("Cannot compare objects for equality"s);
+        return !Greater(lhs, rhs, context);
     }
 
-    bool GreaterOrEqual(const ObjectHolder & /*lhs*/, const ObjectHolder & /*rhs*/, Context & /*context*/)
+    bool GreaterOrEqual(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context)
     {
-        // Заглушка. Реализуйте функцию самостоятельно
-        throw std::runtime_error("Cannot compare objects for equality"s);
+        return !Less(lhs, rhs, context);
     }
 
 } // namespace runtime
\ No newline at end of file
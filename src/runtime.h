@@ -1,11 +1,20 @@
 #pragma once
 
+#include "symbol_table.h"
+
+#include <cstdint>
 #include <memory>
 #include <sstream>
 #include <string>
+#include <type_traits>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
+#ifdef MYTHON_ATOMIC_REFCOUNT
+#include <atomic>
+#endif
+
 namespace runtime
 {
 
@@ -20,29 +29,186 @@ namespace runtime
         ~Context() = default;
     };
 
-    // Базовый класс для всех объектов языка Mython
+    // Базовый класс для всех объектов языка Mython.
+    // Объект сам считает владеющие им ObjectHolder, поэтому Own не выделяет отдельный блок управления
     class Object
     {
     public:
         virtual ~Object() = default;
         // выводит в os своё представление в виде строки
         virtual void Print(std::ostream &os, Context &context) = 0;
+
+    private:
+        friend class ObjectHolder;
+
+        // Счётчик принадлежит конкретному объекту и при копировании объекта не переносится.
+        // Обычного счётчика достаточно, пока ObjectHolder одного объекта не копируют из разных
+        // потоков; атомарный включается через cmake -DMYTHON_ATOMIC_REFCOUNT=ON
+        struct RefCount
+        {
+            RefCount() = default;
+
+            RefCount(const RefCount & /*other*/) noexcept
+            {
+            }
+
+            RefCount &operator=(const RefCount & /*other*/) noexcept
+            {
+                return *this;
+            }
+
+#ifdef MYTHON_ATOMIC_REFCOUNT
+            void Increment() noexcept
+            {
+                value.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            // Возвращает true, если ушла последняя ссылка
+            bool Decrement() noexcept
+            {
+                return value.fetch_sub(1, std::memory_order_acq_rel) == 1;
+            }
+
+            std::atomic<uint32_t> value = 0;
+#else
+            void Increment() noexcept
+            {
+                ++value;
+            }
+
+            bool Decrement() noexcept
+            {
+                return --value == 0;
+            }
+
+            uint32_t value = 0;
+#endif
+        };
+
+        RefCount ref_count_;
+    };
+
+    // Объект-значение, хранящий значение типа T
+    template <typename T>
+    class ValueObject : public Object
+    {
+    public:
+        constexpr ValueObject(T v) // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
+            : value_(v)
+        {
+        }
+
+        void Print(std::ostream &os, [[maybe_unused]] Context &context) override
+        {
+            os << value_;
+        }
+
+        [[nodiscard]] const T &GetValue() const
+        {
+            return value_;
+        }
+
+    private:
+        T value_;
+    };
+
+    // Строковое значение
+    using String = ValueObject<std::string>;
+    // Числовое значение
+    using Number = ValueObject<int>;
+
+    // Логическое значение
+    class Bool : public ValueObject<bool>
+    {
+    public:
+        using ValueObject<bool>::ValueObject;
+
+        void Print(std::ostream &os, Context &context) override;
     };
 
-    // Специальный класс-обёртка, предназначенный для хранения объекта в Mython-программе
+    // Специальный класс-обёртка, предназначенный для хранения объекта в Mython-программе.
+    // Занимает одно слово: указатель на объект, в младших битах которого записано, как объект хранится.
+    // Копии ObjectHolder указывают на один и тот же объект, а указатель из Get() и TryAs действителен,
+    // пока объектом владеет хотя бы один ObjectHolder. Bool хранятся как два неизменяемых объекта
+    // на всю программу, Number - в пуле потока, поэтому в установившемся режиме ни те ни другие
+    // не обращаются к куче
     class ObjectHolder
     {
     public:
         // Создаёт пустое значение
-        ObjectHolder() = default;
+        ObjectHolder() noexcept = default;
+
+        ObjectHolder(const ObjectHolder &other) noexcept
+            : word_(other.word_)
+        {
+            AddRef();
+        }
+
+        ObjectHolder(ObjectHolder &&other) noexcept
+            : word_(std::exchange(other.word_, 0))
+        {
+        }
+
+        // Прежний объект освобождается последним: его деструктор может разрушить other
+        ObjectHolder &operator=(const ObjectHolder &other) noexcept
+        {
+            ObjectHolder copy(other);
+            std::swap(word_, copy.word_);
+            return *this;
+        }
+
+        ObjectHolder &operator=(ObjectHolder &&other) noexcept
+        {
+            ObjectHolder moved(std::move(other));
+            std::swap(word_, moved.word_);
+            return *this;
+        }
+
+        ~ObjectHolder()
+        {
+            switch (GetKind())
+            {
+            case Kind::Owned:
+                if (word_ != 0 && Get()->ref_count_.Decrement())
+                {
+                    delete Get();
+                }
+                break;
+            case Kind::Number:
+                if (Get()->ref_count_.Decrement())
+                {
+                    DeleteNumber(static_cast<Number *>(Get()));
+                }
+                break;
+            default:
+                break;
+            }
+        }
 
         // Возвращает ObjectHolder, владеющий объектом типа T
         // Тип T - конкретный класс-наследник Object.
-        // object копируется или перемещается в кучу
+        // object копируется или перемещается в кучу, Number - в пул потока,
+        // а Bool заменяется общим объектом с тем же значением
         template <typename T>
         [[nodiscard]] static ObjectHolder Own(T &&object)
         {
-            return ObjectHolder(std::make_shared<T>(std::forward<T>(object)));
+            using Type = std::decay_t<T>;
+            if constexpr (std::is_same_v<Type, Bool>)
+            {
+                return ObjectHolder(object.GetValue() ? &true_value_ : &false_value_, Kind::Bool);
+            }
+            else if constexpr (std::is_same_v<Type, Number>)
+            {
+                Number *number = NewNumber(object.GetValue());
+                number->ref_count_.Increment();
+                return ObjectHolder(number, Kind::Number);
+            }
+            else
+            {
+                Object *owned = new Type(std::forward<T>(object));
+                owned->ref_count_.Increment();
+                return ObjectHolder(owned, Kind::Owned);
+            }
         }
 
         // Создаёт ObjectHolder, не владеющий объектом (аналог слабой ссылки)
@@ -56,53 +222,244 @@ namespace runtime
 
         Object *operator->() const;
 
-        [[nodiscard]] Object *Get() const;
+        [[nodiscard]] Object *Get() const
+        {
+            return reinterpret_cast<Object *>(word_ & ~KIND_MASK);
+        }
 
         // Возвращает указатель на объект типа T либо nullptr, если внутри ObjectHolder не хранится
-        // объект данного типа
+        // объект данного типа. Для Number и Bool, созданных через Own, обходится без dynamic_cast
         template <typename T>
         [[nodiscard]] T *TryAs() const
         {
-            return dynamic_cast<T *>(this->Get());
+            switch (GetKind())
+            {
+            case Kind::Number:
+                return StaticCast<T, Number>();
+            case Kind::Bool:
+                return StaticCast<T, Bool>();
+            default:
+                return dynamic_cast<T *>(Get());
+            }
         }
 
         // Возвращает true, если ObjectHolder не пуст
-        explicit operator bool() const;
+        explicit operator bool() const
+        {
+            return word_ != 0;
+        }
 
     private:
-        explicit ObjectHolder(std::shared_ptr<Object> data);
-        void AssertIsValid() const;
+        // Способ хранения в младших битах word_
+        enum class Kind : uintptr_t
+        {
+            // Объект в куче со счётчиком ссылок; нулевое слово - пустой ObjectHolder
+            Owned,
+            // Объект не принадлежит ObjectHolder
+            Shared,
+            // Number из пула потока со счётчиком ссылок
+            Number,
+            // Один из объектов true_value_ и false_value_
+            Bool,
+        };
+
+        static constexpr uintptr_t KIND_MASK = 3;
+        static_assert(alignof(Object) > KIND_MASK, "младшие биты указателя на Object должны быть свободны");
+
+        ObjectHolder(Object *object, Kind kind) noexcept
+            : word_(reinterpret_cast<uintptr_t>(object) | static_cast<uintptr_t>(kind))
+        {
+        }
+
+        [[nodiscard]] Kind GetKind() const
+        {
+            return static_cast<Kind>(word_ & KIND_MASK);
+        }
+
+        void AddRef() const noexcept
+        {
+            const Kind kind = GetKind();
+            if ((kind == Kind::Owned && word_ != 0) || kind == Kind::Number)
+            {
+                Get()->ref_count_.Increment();
+            }
+        }
+
+        // Тип Stored известен по тегу, поэтому приведение к T не требует dynamic_cast
+        template <typename T, typename Stored>
+        [[nodiscard]] T *StaticCast() const
+        {
+            if constexpr (std::is_base_of_v<T, Stored>)
+            {
+                return static_cast<Stored *>(Get());
+            }
+            else
+            {
+                return nullptr;
+            }
+        }
+
+        // Берут память под Number из пула текущего потока и возвращают её туда
+        static Number *NewNumber(int value);
+        static void DeleteNumber(Number *number) noexcept;
 
-        std::shared_ptr<Object> data_;
+        static Bool true_value_;
+        static Bool false_value_;
+
+        uintptr_t word_ = 0;
     };
 
-    // Объект-значение, хранящий значение типа T
-    template <typename T>
-    class ValueObject : public Object
+    static_assert(sizeof(ObjectHolder) == sizeof(void *));
+
+    // Таблица имён исполняемой программы (см. SymbolScope). Вне SymbolScope - таблица
+    // текущего потока, которая освобождается при его завершении
+    symbols::SymbolTable &Symbols();
+
+    // Делает symbols таблицей имён текущего потока до разрушения SymbolScope. Интерпретатор
+    // передаёт сюда таблицу лексера программы (parse::Lexer::Symbols), чтобы номера
+    // parse::token_type::Id::symbol совпадали с ключами Closure
+    class SymbolScope
     {
     public:
-        ValueObject(T v) // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
-            : value_(v)
+        explicit SymbolScope(std::shared_ptr<symbols::SymbolTable> symbols);
+        ~SymbolScope();
+
+        SymbolScope(const SymbolScope &) = delete;
+        SymbolScope &operator=(const SymbolScope &) = delete;
+
+    private:
+        std::shared_ptr<symbols::SymbolTable> symbols_;
+        symbols::SymbolTable *previous_;
+    };
+
+    // Таблица символов, связывающая имя объекта с его значением.
+    // Ключ - номер имени в таблице, которая была текущей (см. Symbols()) при создании Closure,
+    // поэтому поиск не хеширует и не сравнивает строки. Перегрузки с именем ищут и интернируют
+    // его в той же таблице, где бы ни был сделан вызов. Таблица должна жить дольше Closure
+    class Closure
+    {
+    public:
+        using Map = std::unordered_map<symbols::SymbolId, ObjectHolder>;
+        using iterator = Map::iterator;
+        using const_iterator = Map::const_iterator;
+
+        Closure()
+            : symbols_(&Symbols())
         {
         }
 
-        void Print(std::ostream &os, [[maybe_unused]] Context &context) override
+        explicit Closure(symbols::SymbolTable &symbols)
+            : symbols_(&symbols)
         {
-            os << value_;
         }
 
-        [[nodiscard]] const T &GetValue() const
+        // Таблица, номера имён которой служат ключами
+        [[nodiscard]] symbols::SymbolTable &Table() const
         {
-            return value_;
+            return *symbols_;
+        }
+
+        ObjectHolder &operator[](symbols::SymbolId id)
+        {
+            return values_[id];
+        }
+
+        ObjectHolder &operator[](std::string_view name)
+        {
+            return values_[symbols_->Intern(name).id];
+        }
+
+        [[nodiscard]] iterator find(symbols::SymbolId id)
+        {
+            return values_.find(id);
+        }
+
+        [[nodiscard]] const_iterator find(symbols::SymbolId id) const
+        {
+            return values_.find(id);
+        }
+
+        [[nodiscard]] iterator find(std::string_view name)
+        {
+            auto id = symbols_->Find(name);
+            return id ? values_.find(*id) : values_.end();
+        }
+
+        [[nodiscard]] const_iterator find(std::string_view name) const
+        {
+            auto id = symbols_->Find(name);
+            return id ? values_.find(*id) : values_.end();
+        }
+
+        // Выбрасывают std::out_of_range, если имени нет в таблице
+        [[nodiscard]] ObjectHolder &at(symbols::SymbolId id)
+        {
+            return values_.at(id);
+        }
+
+        [[nodiscard]] const ObjectHolder &at(symbols::SymbolId id) const
+        {
+            return values_.at(id);
+        }
+
+        [[nodiscard]] ObjectHolder &at(std::string_view name);
+        [[nodiscard]] const ObjectHolder &at(std::string_view name) const;
+
+        [[nodiscard]] size_t count(symbols::SymbolId id) const
+        {
+            return values_.count(id);
+        }
+
+        [[nodiscard]] size_t count(std::string_view name) const
+        {
+            return find(name) != values_.end() ? 1 : 0;
+        }
+
+        size_t erase(symbols::SymbolId id)
+        {
+            return values_.erase(id);
+        }
+
+        [[nodiscard]] size_t size() const
+        {
+            return values_.size();
+        }
+
+        [[nodiscard]] bool empty() const
+        {
+            return values_.empty();
+        }
+
+        void clear()
+        {
+            values_.clear();
+        }
+
+        iterator begin()
+        {
+            return values_.begin();
+        }
+
+        iterator end()
+        {
+            return values_.end();
+        }
+
+        [[nodiscard]] const_iterator begin() const
+        {
+            return values_.begin();
+        }
+
+        [[nodiscard]] const_iterator end() const
+        {
+            return values_.end();
         }
 
     private:
-        T value_;
+        symbols::SymbolTable *symbols_;
+        Map values_;
     };
 
-    // Таблица символов, связывающая имя объекта с его значением
-    using Closure = std::unordered_map<std::string, ObjectHolder>;
-
     // Проверяет, содержится ли в object значение, приводимое к True
     // Для отличных от нуля чисел, True и непустых строк возвращается true. В остальных случаях - false.
     bool IsTrue(const ObjectHolder &object);
@@ -117,20 +474,6 @@ namespace runtime
         virtual ObjectHolder Execute(Closure &closure, Context &context) = 0;
     };
 
-    // Строковое значение
-    using String = ValueObject<std::string>;
-    // Числовое значение
-    using Number = ValueObject<int>;
-
-    // Логическое значение
-    class Bool : public ValueObject<bool>
-    {
-    public:
-        using ValueObject<bool>::ValueObject;
-
-        void Print(std::ostream &os, Context &context) override;
-    };
-
     // Метод класса
     struct Method
     {
@@ -158,6 +501,11 @@ namespace runtime
 
         // Выводит в os строку "Class <имя класса>", например "Class cat"
         void Print(std::ostream &os, Context &context) override;
+
+    private:
+        std::string name_;
+        std::vector<Method> methods_;
+        const Class *parent_;
     };
 
     // Экземпляр класса
@@ -188,6 +536,10 @@ namespace runtime
         [[nodiscard]] Closure &Fields();
         // Возвращает константную ссылку на Closure, содержащую поля объекта
         [[nodiscard]] const Closure &Fields() const;
+
+    private:
+        const Class &cls_;
+        Closure fields_;
     };
 
     /*
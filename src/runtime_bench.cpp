@@ -0,0 +1,179 @@
+#include "bench_util.h"
+#include "runtime.h"
+
+#include <charconv>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+using bench::Measure;
+using bench::Run;
+
+namespace
+{
+    const char USAGE[] = "Usage: runtime_bench [ROUNDS]\n"
+                         "ROUNDS - number of copy rounds over 1024 handles, 20000 by default\n";
+
+    // Разбирает положительное целое, записанное в arg целиком
+    bool ParseCount(string_view arg, size_t &count)
+    {
+        const auto [end, error] = from_chars(arg.data(), arg.data() + arg.size(), count);
+        return error == errc{} && end == arg.data() + arg.size() && count > 0;
+    }
+
+    // Прежнее устройство ObjectHolder: std::shared_ptr с блоком управления из make_shared
+    struct SharedHandle
+    {
+        template <typename T>
+        static SharedHandle Own(T &&object)
+        {
+            return {make_shared<T>(std::forward<T>(object))};
+        }
+
+        static SharedHandle Share(runtime::Object &object)
+        {
+            return {shared_ptr<runtime::Object>(&object, [](auto * /*p*/) {})};
+        }
+
+        [[nodiscard]] int Number() const
+        {
+            return dynamic_cast<const runtime::Number &>(*data).GetValue();
+        }
+
+        shared_ptr<runtime::Object> data;
+    };
+
+    // ObjectHolder с тем же интерфейсом, что у SharedHandle
+    struct IntrusiveHandle
+    {
+        template <typename T>
+        static IntrusiveHandle Own(T &&object)
+        {
+            return {runtime::ObjectHolder::Own(std::forward<T>(object))};
+        }
+
+        static IntrusiveHandle Share(runtime::Object &object)
+        {
+            return {runtime::ObjectHolder::Share(object)};
+        }
+
+        [[nodiscard]] int Number() const
+        {
+            return data.TryAs<runtime::Number>()->GetValue();
+        }
+
+        runtime::ObjectHolder data;
+    };
+
+    void Report(const string &name, size_t operations, const Measure &m)
+    {
+        cout << name << ": " << m.seconds * 1e9 / operations << " ns/op, "
+             << static_cast<double>(m.allocations) / operations << " allocs/op" << endl;
+    }
+
+    // Копирование и разрушение: rounds раз копирует handles ручек в заранее выделенный вектор
+    // и очищает его. На каждую строку в куче приходится четыре ручки
+    template <typename Handle>
+    void CompareCopy(const string &name, size_t handles, size_t rounds)
+    {
+        vector<Handle> source;
+        source.reserve(handles);
+        for (size_t i = 0; i < handles; ++i)
+        {
+            if (i % 4 == 0)
+            {
+                source.push_back(Handle::Own(runtime::String{to_string(i)}));
+            }
+            else
+            {
+                source.push_back(source[i - i % 4]);
+            }
+        }
+
+        vector<Handle> copies;
+        copies.reserve(handles);
+        auto copy = Run([&]
+                        {
+                            for (size_t round = 0; round < rounds; ++round)
+                            {
+                                copies.assign(source.begin(), source.end());
+                                copies.clear();
+                            } });
+        Report(name + " copy + destroy", handles * rounds, copy);
+    }
+
+    // Создание невладеющей ручки на объект, живущий вне ObjectHolder
+    template <typename Handle>
+    void CompareShare(const string &name, size_t rounds)
+    {
+        runtime::Number number(1);
+        size_t checksum = 0;
+        auto share = Run([&]
+                         {
+                             for (size_t round = 0; round < rounds; ++round)
+                             {
+                                 Handle handle = Handle::Share(number);
+                                 checksum += static_cast<bool>(handle.data);
+                             } });
+        Report(name + " Share         ", rounds, share);
+        if (checksum != rounds)
+        {
+            cout << "unexpected checksum " << checksum << endl;
+        }
+    }
+
+    // Цикл вида "while i < n: i = i + 1", где каждое новое значение i - новый Number
+    template <typename Handle>
+    void CompareIntegerLoop(const string &name, int iterations)
+    {
+        auto loop = Run([&]
+                        {
+                            Handle i = Handle::Own(runtime::Number{0});
+                            const Handle limit = Handle::Own(runtime::Number{iterations});
+                            while (i.Number() < limit.Number())
+                            {
+                                i = Handle::Own(runtime::Number{i.Number() + 1});
+                            }
+                            if (i.Number() != iterations)
+                            {
+                                cout << "unexpected result " << i.Number() << endl;
+                            } });
+        Report(name + " integer loop  ", iterations, loop);
+    }
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    size_t rounds = 20000;
+    if (argc > 2 || (argc == 2 && !ParseCount(argv[1], rounds)))
+    {
+        cerr << USAGE;
+        return 2;
+    }
+    constexpr size_t handles = 1024;
+
+    cout << "sizeof: std::shared_ptr<Object> " << sizeof(shared_ptr<runtime::Object>) << ", ObjectHolder "
+         << sizeof(runtime::ObjectHolder) << endl;
+    auto compare = [&]
+    {
+        CompareCopy<SharedHandle>("shared_ptr  ", handles, rounds);
+        CompareCopy<IntrusiveHandle>("ObjectHolder", handles, rounds);
+        CompareShare<SharedHandle>("shared_ptr  ", handles * rounds / 16);
+        CompareShare<IntrusiveHandle>("ObjectHolder", handles * rounds / 16);
+        CompareIntegerLoop<SharedHandle>("shared_ptr  ", static_cast<int>(handles * rounds / 16));
+        CompareIntegerLoop<IntrusiveHandle>("ObjectHolder", static_cast<int>(handles * rounds / 16));
+    };
+    compare();
+
+    // libstdc++ переводит счётчики shared_ptr на атомарные операции, как только в процессе
+    // запущен хотя бы один поток (например, параллельным разбором файлов)
+    thread([] {}).join();
+    cout << "after a thread has started:" << endl;
+    compare();
+    return 0;
+}
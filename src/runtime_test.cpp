@@ -2,6 +2,7 @@
 #include "test_runner_r.h"
 
 #include <functional>
+#include <thread>
 
 using namespace std;
 
@@ -261,6 +262,123 @@ namespace runtime
             }
         }
 
+        void TestCopy()
+        {
+            ASSERT_EQUAL(Logger::instance_count, 0);
+            {
+                auto one = ObjectHolder::Own(Logger(5));
+                {
+                    ObjectHolder two = one;
+                    ObjectHolder three;
+                    three = two;
+                    ASSERT(three.Get() == one.Get());
+                    ASSERT_EQUAL(Logger::instance_count, 1);
+                }
+                ASSERT_EQUAL(Logger::instance_count, 1);
+
+                // Присваивание самому себе не освобождает объект
+                ObjectHolder &alias = one;
+                one = alias;
+                ASSERT_EQUAL(Logger::instance_count, 1);
+
+                one = ObjectHolder::None();
+                ASSERT_EQUAL(Logger::instance_count, 0);
+            }
+            {
+                Logger logger(7);
+                auto shared = ObjectHolder::Share(logger);
+                ObjectHolder copy = shared;
+                shared = ObjectHolder::None();
+                ASSERT(copy.Get() == &logger);
+                ASSERT_EQUAL(Logger::instance_count, 1);
+            }
+            ASSERT_EQUAL(Logger::instance_count, 0);
+        }
+
+        void TestImmediates()
+        {
+            auto number = ObjectHolder::Own(Number{42});
+            ASSERT(number);
+            ASSERT(number.TryAs<Number>() != nullptr && number.TryAs<Number>()->GetValue() == 42);
+            ASSERT(number.TryAs<Bool>() == nullptr);
+            ASSERT(number.TryAs<String>() == nullptr);
+            ASSERT(number.TryAs<Object>() == number.Get());
+
+            // Копии указывают на один объект, и указатель на него переживает перезапись источника
+            ObjectHolder copy = number;
+            ASSERT(copy.Get() == number.Get());
+            const Number *value = number.TryAs<Number>();
+            number = ObjectHolder::Own(Bool{true});
+            ASSERT_EQUAL(value->GetValue(), 42);
+            ASSERT(copy.TryAs<Number>() == value);
+            ASSERT(number.TryAs<Bool>()->GetValue());
+            ASSERT(number.TryAs<Number>() == nullptr);
+            ASSERT(number.TryAs<String>() == nullptr);
+            ASSERT(ObjectHolder::Own(Bool{true}).Get() == number.Get());
+            ASSERT(ObjectHolder::Own(Bool{false}).Get() != number.Get());
+
+            // Перемещение не меняет адрес объекта
+            ObjectHolder moved = std::move(copy);
+            ASSERT(!copy); // NOLINT
+            ASSERT(moved.TryAs<Number>() == value);
+            ASSERT_EQUAL(moved.TryAs<Number>()->GetValue(), 42);
+
+            DummyContext context;
+            moved->Print(context.output, context);
+            number->Print(context.output, context);
+            ASSERT_EQUAL(context.output.str(), "42True"s);
+
+            // Число, на которое ссылается Share, сравнивается с созданным через Own
+            Number shared(42);
+            ASSERT(Equal(ObjectHolder::Share(shared), moved, context));
+            ASSERT(Less(moved, ObjectHolder::Own(Number{43}), context));
+            ASSERT(!Less(moved, ObjectHolder::Share(shared), context));
+            ASSERT_THROWS(Equal(moved, number, context), runtime_error);
+        }
+
+        void TestClosureSymbols()
+        {
+            auto first = make_shared<symbols::SymbolTable>();
+            auto second = make_shared<symbols::SymbolTable>();
+            // В таблицах одно и то же имя получает разные номера
+            second->Intern("other"sv);
+
+            Closure closure = [&]
+            {
+                SymbolScope scope(first);
+                Closure fields;
+                fields["x"s] = ObjectHolder::Own(Number{1});
+                return fields;
+            }();
+            ASSERT_EQUAL(&closure.Table(), first.get());
+
+            // Имена ищутся в таблице Closure, а не в текущей
+            SymbolScope scope(second);
+            ASSERT_EQUAL(closure.count("x"s), 1U);
+            ASSERT_EQUAL(closure.count("other"s), 0U);
+            ASSERT_EQUAL(closure.at("x"s).TryAs<Number>()->GetValue(), 1);
+            closure["other"s] = ObjectHolder::Own(Number{2});
+            ASSERT(first->Find("other"sv).has_value());
+            ASSERT_EQUAL(closure.size(), 2U);
+        }
+
+        void TestNumberPoolThreadExit()
+        {
+            std::thread([]
+                        {
+                            // late создан раньше пула и разрушается после его освобождения
+                            thread_local ObjectHolder late;
+                            late = ObjectHolder::Own(Number{-1});
+                            int sum = 0;
+                            for (int i = 0; i < 100; ++i)
+                            {
+                                sum += ObjectHolder::Own(Number{i}).TryAs<Number>()->GetValue();
+                            }
+                            ASSERT_EQUAL(sum, 4950);
+                        })
+                .join();
+        }
+
         void TestNullptr()
         {
             ObjectHolder oh;
@@ -582,7 +700,11 @@ namespace runtime
         RUN_TEST(tr, runtime::TestNonowning);
         RUN_TEST(tr, runtime::TestOwning);
         RUN_TEST(tr, runtime::TestMove);
+        RUN_TEST(tr, runtime::TestCopy);
+        RUN_TEST(tr, runtime::TestImmediates);
         RUN_TEST(tr, runtime::TestNullptr);
+        RUN_TEST(tr, runtime::TestClosureSymbols);
+        RUN_TEST(tr, runtime::TestNumberPoolThreadExit);
     }
 
 } // namespace runtime
\ No newline at end of file
@@ -0,0 +1,102 @@
+#include "symbol_table.h"
+
+#include <algorithm>
+#include <mutex>
+
+namespace symbols
+{
+
+    Symbol SymbolTable::Intern(std::string_view name)
+    {
+        const size_t hash = std::hash<std::string_view>{}(name);
+        {
+            std::shared_lock lock(mutex_);
+            if (!slots_.empty())
+            {
+                if (SymbolId id = slots_[FindSlot(name, hash)]; id != NO_SYMBOL)
+                {
+                    return {id, names_[id]};
+                }
+            }
+        }
+
+        std::unique_lock lock(mutex_);
+        if (2 * (names_.size() + 1) > slots_.size())
+        {
+            Grow();
+        }
+        SymbolId &slot = slots_[FindSlot(name, hash)];
+        if (slot == NO_SYMBOL)
+        {
+            slot = static_cast<SymbolId>(names_.size());
+            names_.push_back(Store(name));
+        }
+        return {slot, names_[slot]};
+    }
+
+    size_t SymbolTable::FindSlot(std::string_view name, size_t hash) const
+    {
+        const size_t mask = slots_.size() - 1;
+        size_t i = hash & mask;
+        while (slots_[i] != NO_SYMBOL && names_[slots_[i]] != name)
+        {
+            i = (i + 1) & mask;
+        }
+        return i;
+    }
+
+    std::string_view SymbolTable::Store(std::string_view name)
+    {
+        if (name.size() > block_left_)
+        {
+            const size_t size = std::max(BLOCK_SIZE, name.size());
+            blocks_.push_back(std::make_unique<char[]>(size));
+            block_pos_ = blocks_.back().get();
+            block_left_ = size;
+        }
+        char *stored = block_pos_;
+        std::copy(name.begin(), name.end(), stored);
+        block_pos_ += name.size();
+        block_left_ -= name.size();
+        return {stored, name.size()};
+    }
+
+    void SymbolTable::Grow()
+    {
+        slots_.assign(std::max<size_t>(64, 2 * slots_.size()), NO_SYMBOL);
+        const size_t mask = slots_.size() - 1;
+        for (SymbolId id = 0; id < names_.size(); ++id)
+        {
+            size_t i = std::hash<std::string_view>{}(names_[id]) & mask;
+            while (slots_[i] != NO_SYMBOL)
+            {
+                i = (i + 1) & mask;
+            }
+            slots_[i] = id;
+        }
+    }
+
+    std::optional<SymbolId> SymbolTable::Find(std::string_view name) const
+    {
+        std::shared_lock lock(mutex_);
+        if (slots_.empty())
+        {
+            return std::nullopt;
+        }
+        const SymbolId id = slots_[FindSlot(name, std::hash<std::string_view>{}(name))];
+        return id != NO_SYMBOL ? std::optional(id) : std::nullopt;
+    }
+
+    std::string_view SymbolTable::Name(SymbolId id) const
+    {
+        std::shared_lock lock(mutex_);
+        return names_.at(id);
+    }
+
+    size_t SymbolTable::Size() const
+    {
+        std::shared_lock lock(mutex_);
+        return names_.size();
+    }
+
+} // namespace symbols
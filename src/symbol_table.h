@@ -0,0 +1,100 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace symbols
+{
+
+    // Плотный целочисленный номер интернированного имени
+    using SymbolId = uint32_t;
+
+    // Номер имени, которое не интернировано ни в одной таблице
+    inline constexpr SymbolId NO_SYMBOL = std::numeric_limits<SymbolId>::max();
+
+    // Номер имени вместе с его строкой, которая живёт, пока жива таблица
+    struct Symbol
+    {
+        SymbolId id = NO_SYMBOL;
+        std::string_view name;
+    };
+
+    // Таблица интернированных имён. Одинаковые имена получают одинаковый SymbolId,
+    // поэтому сравнение и поиск по имени сводятся к операциям над целыми числами.
+    // Общей таблицы нет: её заводит каждый Lexer, и она освобождается вместе с последним
+    // владельцем (лексером, TokenStream или рабочей средой, см. runtime::SymbolScope).
+    // Потокобезопасна, так как параллельный разбор интернирует имена из нескольких потоков
+    class SymbolTable
+    {
+    public:
+        // Возвращает номер и строку имени name, при необходимости добавляя его в таблицу.
+        // Уже известное имя находится за один поиск под разделяемой блокировкой
+        Symbol Intern(std::string_view name);
+
+        // Возвращает номер имени name, не добавляя его в таблицу
+        [[nodiscard]] std::optional<SymbolId> Find(std::string_view name) const;
+
+        // Возвращает имя по номеру. Строка живёт, пока жива таблица
+        [[nodiscard]] std::string_view Name(SymbolId id) const;
+
+        [[nodiscard]] size_t Size() const;
+
+    private:
+        // Ищет слот имени name с хешем hash: занятый этим именем или первый свободный
+        [[nodiscard]] size_t FindSlot(std::string_view name, size_t hash) const;
+        // Копирует name в блок памяти таблицы
+        std::string_view Store(std::string_view name);
+        // Удваивает число слотов
+        void Grow();
+
+        static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+        mutable std::shared_mutex mutex_;
+        // Строки имён лежат в крупных блоках и не перемещаются, поэтому на новое имя
+        // обычно не приходится ни одного выделения памяти
+        std::vector<std::unique_ptr<char[]>> blocks_;
+        char *block_pos_ = nullptr;
+        size_t block_left_ = 0;
+        std::vector<std::string_view> names_;
+        // Открытая адресация с линейным пробированием: номер имени или NO_SYMBOL.
+        // Число слотов - степень двойки, заполнено не больше половины
+        std::vector<SymbolId> slots_;
+    };
+
+    // Кэш прямого отображения перед SymbolTable для одного потока. Повторяющиеся имена
+    // находятся в нём без блокировки таблицы; при промахе имя интернируется в таблице
+    class SymbolCache
+    {
+    public:
+        explicit SymbolCache(SymbolTable &table) : table_(&table) {}
+
+        Symbol Intern(std::string_view name)
+        {
+            Symbol &entry = entries_[std::hash<std::string_view>{}(name) % SIZE];
+            if (entry.name != name || entry.id == NO_SYMBOL)
+            {
+                entry = table_->Intern(name);
+            }
+            return entry;
+        }
+
+        [[nodiscard]] SymbolTable &Table() const
+        {
+            return *table_;
+        }
+
+    private:
+        static constexpr size_t SIZE = 256;
+
+        SymbolTable *table_;
+        std::array<Symbol, SIZE> entries_{};
+    };
+
+} // namespace symbols
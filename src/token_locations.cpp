@@ -0,0 +1,156 @@
+#include "token_locations.h"
+
+#include <algorithm>
+
+namespace parse
+{
+
+    namespace
+    {
+        // Разность столбцов в одной строке может быть отрицательной, знак переносится в младший бит
+        uint32_t ZigZag(int64_t value)
+        {
+            return static_cast<uint32_t>((value << 1) ^ (value >> 63));
+        }
+
+        int64_t UnZigZag(uint32_t value)
+        {
+            return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+        }
+
+        void WriteVarint(std::vector<uint8_t> &out, uint32_t value)
+        {
+            while (value >= 0x80)
+            {
+                out.push_back(static_cast<uint8_t>(value | 0x80));
+                value >>= 7;
+            }
+            out.push_back(static_cast<uint8_t>(value));
+        }
+
+        uint32_t ReadVarint(const std::vector<uint8_t> &in, size_t &offset)
+        {
+            uint32_t value = 0;
+            for (int shift = 0;; shift += 7)
+            {
+                const uint8_t byte = in[offset++];
+                value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+                if (!(byte & 0x80))
+                {
+                    return value;
+                }
+            }
+        }
+    } // namespace
+
+    TokenLocations::Reader::Reader(const TokenLocations &locations, size_t index)
+        : locations_(locations)
+    {
+        const auto &checkpoint = locations.CheckpointOf(index);
+        offset_ = checkpoint.offset;
+        last_ = checkpoint.last;
+        for (size_t i = index / CHECKPOINT_INTERVAL * CHECKPOINT_INTERVAL; i < index; ++i)
+        {
+            Next();
+        }
+    }
+
+    SourceLocation TokenLocations::Reader::Next()
+    {
+        const int64_t line_delta = UnZigZag(ReadVarint(locations_.bytes_, offset_));
+        const uint32_t column = ReadVarint(locations_.bytes_, offset_);
+        if (line_delta == 0)
+        {
+            last_.column = static_cast<uint32_t>(last_.column + UnZigZag(column));
+        }
+        else
+        {
+            last_.line = static_cast<uint32_t>(last_.line + line_delta);
+            last_.column = column;
+        }
+        return last_;
+    }
+
+    void TokenLocations::Push(SourceLocation location)
+    {
+        if (size_ % CHECKPOINT_INTERVAL == 0)
+        {
+            checkpoints_.push_back({bytes_.size(), last_});
+        }
+
+        const int64_t line_delta = static_cast<int64_t>(location.line) - last_.line;
+        WriteVarint(bytes_, ZigZag(line_delta));
+        if (line_delta == 0)
+        {
+            WriteVarint(bytes_, ZigZag(static_cast<int64_t>(location.column) - last_.column));
+        }
+        else
+        {
+            WriteVarint(bytes_, location.column);
+        }
+        last_ = location;
+        ++size_;
+    }
+
+    SourceLocation TokenLocations::operator[](size_t index) const
+    {
+        return Reader(*this, index).Next();
+    }
+
+    void TokenLocations::Truncate(size_t size)
+    {
+        if (size >= size_)
+        {
+            return;
+        }
+        if (size == 0)
+        {
+            *this = {};
+            return;
+        }
+
+        // Позиция последнего оставшегося токена становится отправной для следующих
+        Reader reader(*this, size - 1);
+        last_ = reader.Next();
+        bytes_.resize(reader.offset_);
+        checkpoints_.resize((size - 1) / CHECKPOINT_INTERVAL + 1 - released_checkpoints_);
+        size_ = size;
+    }
+
+    void TokenLocations::Release(size_t index)
+    {
+        const size_t count = std::min(index, size_) / CHECKPOINT_INTERVAL - released_checkpoints_;
+        if (count == 0 || count < checkpoints_.size() / 2)
+        {
+            return;
+        }
+
+        const size_t offset = count < checkpoints_.size() ? checkpoints_[count].offset : bytes_.size();
+        bytes_.erase(bytes_.begin(), bytes_.begin() + offset);
+        checkpoints_.erase(checkpoints_.begin(), checkpoints_.begin() + count);
+        for (auto &checkpoint : checkpoints_)
+        {
+            checkpoint.offset -= offset;
+        }
+        released_checkpoints_ += count;
+    }
+
+    void TokenLocations::Append(const TokenLocations &other, size_t first, size_t last)
+    {
+        if (first == last)
+        {
+            return;
+        }
+        Reader reader(other, first);
+        for (size_t i = first; i < last; ++i)
+        {
+            Push(reader.Next());
+        }
+    }
+
+    size_t TokenLocations::MemoryUsage() const
+    {
+        return bytes_.capacity() + checkpoints_.capacity() * sizeof(Checkpoint);
+    }
+
+} // namespace parse
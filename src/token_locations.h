@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace parse
+{
+
+    // Позиция в исходном тексте, строки и столбцы считаются с 1
+    struct SourceLocation
+    {
+        uint32_t line = 0;
+        uint32_t column = 0;
+
+        bool operator==(const SourceLocation &) const = default;
+    };
+
+    // Позиции токенов по их номерам в потоке, хранимые отдельно от самих токенов.
+    // Каждая позиция кодируется разностью с предыдущей: приращение строки и столбец
+    // (или приращение столбца в той же строке) в формате varint, обычно 2 байта на токен.
+    // Каждые CHECKPOINT_INTERVAL токенов запоминается полная позиция, так что поиск
+    // по номеру раскодирует не больше CHECKPOINT_INTERVAL записей
+    class TokenLocations
+    {
+    public:
+        static constexpr size_t CHECKPOINT_INTERVAL = 64;
+
+        // Последовательное чтение позиций, начиная с заданного номера
+        class Reader
+        {
+        public:
+            Reader(const TokenLocations &locations, size_t index);
+
+            SourceLocation Next();
+
+        private:
+            friend class TokenLocations;
+
+            const TokenLocations &locations_;
+            size_t offset_;
+            SourceLocation last_;
+        };
+
+        void Push(SourceLocation location);
+
+        [[nodiscard]] SourceLocation operator[](size_t index) const;
+
+        [[nodiscard]] size_t Size() const
+        {
+            return size_;
+        }
+
+        // Номер первой позиции, которая ещё хранится (см. Release)
+        [[nodiscard]] size_t Released() const
+        {
+            return released_checkpoints_ * CHECKPOINT_INTERVAL;
+        }
+
+        // Оставляет первые size позиций. size не меньше Released()
+        void Truncate(size_t size);
+
+        // Разрешает освободить позиции до index. Память освобождается целыми интервалами
+        // между контрольными точками и не чаще, чем освобождается половина хранимого
+        void Release(size_t index);
+
+        // Дописывает позиции [first, last) из other
+        void Append(const TokenLocations &other, size_t first, size_t last);
+
+        // Объём закодированных данных и контрольных точек
+        [[nodiscard]] size_t MemoryUsage() const;
+
+    private:
+        struct Checkpoint
+        {
+            size_t offset;
+            // Позиция перед первым токеном интервала, от неё отсчитывается первая разность
+            SourceLocation last;
+        };
+
+        // Контрольная точка позиции index
+        [[nodiscard]] const Checkpoint &CheckpointOf(size_t index) const
+        {
+            return checkpoints_[index / CHECKPOINT_INTERVAL - released_checkpoints_];
+        }
+
+        std::vector<uint8_t> bytes_;
+        std::vector<Checkpoint> checkpoints_;
+        // Сколько первых контрольных точек освобождено вместе с их позициями
+        size_t released_checkpoints_ = 0;
+        SourceLocation last_;
+        size_t size_ = 0;
+    };
+
+} // namespace parse
@@ -0,0 +1,358 @@
+#include "token_stream.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+
+namespace parse
+{
+
+    namespace
+    {
+        // Токены без значения, восстанавливаемые по номеру типа
+        template <size_t... I>
+        constexpr auto MakeUnvaluedFactories(std::index_sequence<I...>)
+        {
+            return std::array<Token (*)(), sizeof...(I)>{+[]
+                                                         {
+                                                             using Alternative = std::variant_alternative_t<I, TokenBase>;
+                                                             if constexpr (std::is_empty_v<Alternative>)
+                                                             {
+                                                                 return Token(Alternative{});
+                                                             }
+                                                             else
+                                                             {
+                                                                 return Token(token_type::Eof{});
+                                                             }
+                                                         }...};
+        }
+
+        constexpr auto unvalued_factories =
+            MakeUnvaluedFactories(std::make_index_sequence<std::variant_size_v<TokenBase>>());
+
+        // Формат файла .mytok: заголовок, затем массивы
+        //   kinds[token_count], выровненный до 4 байт
+        //   payloads[token_count], у Id - номер имени в списке имён файла
+        //   string_offsets[string_count + 1], symbol_offsets[symbol_count + 1]
+        //   big_numbers[big_number_count]
+        //   strings[strings_size], symbols[symbols_size]
+        // Номера SymbolId не переживают перезапуск процесса, поэтому имена хранятся отдельно
+        // и интернируются заново при загрузке
+        constexpr char CACHE_MAGIC[8] = {'M', 'Y', 'T', 'O', 'K', 0, 0, 2};
+
+        struct CacheHeader
+        {
+            char magic[8];
+            uint64_t source_hash;
+            uint64_t token_count;
+            uint64_t string_count;
+            uint64_t strings_size;
+            uint64_t symbol_count;
+            uint64_t symbols_size;
+            uint64_t big_number_count;
+        };
+
+        size_t AlignTo4(size_t size)
+        {
+            return (size + 3) & ~size_t(3);
+        }
+
+        template <typename T>
+        void WriteArray(std::ostream &out, const T *data, size_t count)
+        {
+            out.write(reinterpret_cast<const char *>(data), static_cast<std::streamsize>(count * sizeof(T)));
+        }
+
+        // Последовательно читает массивы из отображённого файла, проверяя границы
+        class CacheReader
+        {
+        public:
+            explicit CacheReader(std::string_view data) : data_(data) {}
+
+            const char *Take(size_t size)
+            {
+                if (size > data_.size() - pos_)
+                {
+                    return nullptr;
+                }
+                const char *result = data_.data() + pos_;
+                pos_ += size;
+                return result;
+            }
+
+            template <typename T>
+            bool ReadArray(std::vector<T> &out, size_t count)
+            {
+                const char *data = Take(count * sizeof(T));
+                if (!data)
+                {
+                    return false;
+                }
+                // Массивы в файле могут быть не выровнены под T, поэтому копируем побайтово
+                out.resize(count);
+                if (count > 0)
+                {
+                    std::memcpy(out.data(), data, count * sizeof(T));
+                }
+                return true;
+            }
+
+        private:
+            std::string_view data_;
+            size_t pos_ = 0;
+        };
+
+        // Смещения должны неубывать и не выходить за размер пула
+        bool ValidOffsets(const std::vector<uint32_t> &offsets, uint64_t pool_size)
+        {
+            return offsets.front() == 0 && offsets.back() == pool_size &&
+                   std::is_sorted(offsets.begin(), offsets.end());
+        }
+    } // namespace
+
+    uint64_t HashSource(std::string_view source)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (unsigned char c : source)
+        {
+            hash = (hash ^ c) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    TokenStream::TokenStream(std::shared_ptr<symbols::SymbolTable> symbols)
+        : symbols_(symbols ? std::move(symbols) : std::make_shared<symbols::SymbolTable>())
+    {
+    }
+
+    TokenStream::TokenStream(Lexer &lexer)
+        : symbols_(lexer.Symbols())
+    {
+        for (;; lexer.NextToken())
+        {
+            PushBack(lexer.CurrentToken());
+            if (lexer.CurrentToken().Is<token_type::Eof>())
+            {
+                break;
+            }
+        }
+    }
+
+    void TokenStream::PushBack(const Token &token)
+    {
+        using namespace token_type;
+
+        if (!mapping_.View().empty() && token.Is<String>())
+        {
+            // Дописывать можно только в собственный пул
+            strings_.assign(mapped_strings_);
+            mapped_strings_ = {};
+            mapping_ = MappedFile();
+        }
+
+        uint32_t payload = 0;
+        if (auto number = token.TryAs<Number>())
+        {
+            payload = static_cast<uint32_t>(number->value);
+        }
+        else if (auto big = token.TryAs<BigNumber>())
+        {
+            payload = static_cast<uint32_t>(big_numbers_.size());
+            big_numbers_.push_back(big->value);
+        }
+        else if (auto id = token.TryAs<Id>())
+        {
+            // Номер токена может относиться к чужой таблице, поэтому имя интернируется заново
+            payload = symbols_->Intern(id->value).id;
+        }
+        else if (auto c = token.TryAs<Char>())
+        {
+            payload = static_cast<unsigned char>(c->value);
+        }
+        else if (auto str = token.TryAs<String>())
+        {
+            payload = static_cast<uint32_t>(string_offsets_.size() - 1);
+            strings_ += str->value.View();
+            string_offsets_.push_back(static_cast<uint32_t>(strings_.size()));
+        }
+
+        kinds_.push_back(static_cast<uint8_t>(token.index()));
+        payloads_.push_back(payload);
+    }
+
+    Token TokenStream::operator[](size_t i) const
+    {
+        using namespace token_type;
+
+        const uint32_t payload = payloads_[i];
+        switch (kinds_[i])
+        {
+        case TokenKind<Number>():
+            return Number{static_cast<int>(payload)};
+        case TokenKind<BigNumber>():
+            return BigNumber{big_numbers_[payload]};
+        case TokenKind<Id>():
+            return Id{symbols::Symbol{payload, symbols_->Name(payload)}};
+        case TokenKind<Char>():
+            return Char{static_cast<char>(payload)};
+        case TokenKind<String>():
+        {
+            const uint32_t begin = string_offsets_[payload];
+            return String{TokenText(Strings().substr(begin, string_offsets_[payload + 1] - begin))};
+        }
+        default:
+            return unvalued_factories[kinds_[i]]();
+        }
+    }
+
+    size_t TokenStream::MemoryUsage() const
+    {
+        return kinds_.capacity() * sizeof(uint8_t) + payloads_.capacity() * sizeof(uint32_t) +
+               string_offsets_.capacity() * sizeof(uint32_t) + big_numbers_.capacity() * sizeof(int64_t) +
+               strings_.capacity();
+    }
+
+    bool TokenStream::Save(const std::filesystem::path &path, uint64_t source_hash) const
+    {
+        // Список имён файла в порядке первого появления
+        std::unordered_map<symbols::SymbolId, uint32_t> local_ids;
+        std::vector<uint32_t> payloads = payloads_;
+        std::vector<uint32_t> symbol_offsets{0};
+        std::string symbol_names;
+        for (size_t i = 0; i < kinds_.size(); ++i)
+        {
+            if (kinds_[i] != TokenKind<token_type::Id>())
+            {
+                continue;
+            }
+            auto [it, inserted] = local_ids.emplace(payloads[i], static_cast<uint32_t>(local_ids.size()));
+            if (inserted)
+            {
+                symbol_names += symbols_->Name(payloads[i]);
+                symbol_offsets.push_back(static_cast<uint32_t>(symbol_names.size()));
+            }
+            payloads[i] = it->second;
+        }
+
+        const std::string_view strings = Strings();
+        CacheHeader header{};
+        std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        header.source_hash = source_hash;
+        header.token_count = kinds_.size();
+        header.string_count = string_offsets_.size() - 1;
+        header.strings_size = strings.size();
+        header.symbol_count = symbol_offsets.size() - 1;
+        header.symbols_size = symbol_names.size();
+        header.big_number_count = big_numbers_.size();
+
+        auto temp_path = path;
+        temp_path += ".tmp";
+        {
+            std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+            const char padding[4] = {};
+            WriteArray(out, &header, 1);
+            WriteArray(out, kinds_.data(), kinds_.size());
+            WriteArray(out, padding, AlignTo4(kinds_.size()) - kinds_.size());
+            WriteArray(out, payloads.data(), payloads.size());
+            WriteArray(out, string_offsets_.data(), string_offsets_.size());
+            WriteArray(out, symbol_offsets.data(), symbol_offsets.size());
+            WriteArray(out, big_numbers_.data(), big_numbers_.size());
+            WriteArray(out, strings.data(), strings.size());
+            WriteArray(out, symbol_names.data(), symbol_names.size());
+            if (!out.flush())
+            {
+                return false;
+            }
+        }
+
+        std::error_code error;
+        std::filesystem::rename(temp_path, path, error);
+        return !error;
+    }
+
+    std::optional<TokenStream> TokenStream::Load(const std::filesystem::path &path, uint64_t source_hash,
+                                                 std::shared_ptr<symbols::SymbolTable> symbols)
+    {
+        std::error_code error;
+        if (!std::filesystem::is_regular_file(path, error))
+        {
+            return std::nullopt;
+        }
+
+        TokenStream result(std::move(symbols));
+        try
+        {
+            result.mapping_ = MappedFile::Open(path);
+        }
+        catch (const LexerError &)
+        {
+            return std::nullopt;
+        }
+
+        CacheReader reader(result.mapping_.View());
+        CacheHeader header;
+        const char *header_data = reader.Take(sizeof(header));
+        if (!header_data)
+        {
+            return std::nullopt;
+        }
+        std::memcpy(&header, header_data, sizeof(header));
+        if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.source_hash != source_hash ||
+            header.token_count > result.mapping_.View().size() || header.string_count > header.token_count ||
+            header.symbol_count > header.token_count || header.big_number_count > header.token_count)
+        {
+            return std::nullopt;
+        }
+
+        std::vector<uint32_t> symbol_offsets;
+        if (!reader.ReadArray(result.kinds_, header.token_count) ||
+            !reader.Take(AlignTo4(header.token_count) - header.token_count) ||
+            !reader.ReadArray(result.payloads_, header.token_count) ||
+            !reader.ReadArray(result.string_offsets_, header.string_count + 1) ||
+            !reader.ReadArray(symbol_offsets, header.symbol_count + 1) ||
+            !reader.ReadArray(result.big_numbers_, header.big_number_count) ||
+            !ValidOffsets(result.string_offsets_, header.strings_size) ||
+            !ValidOffsets(symbol_offsets, header.symbols_size))
+        {
+            return std::nullopt;
+        }
+        const char *strings = reader.Take(header.strings_size);
+        const char *names = reader.Take(header.symbols_size);
+        if (!strings || !names)
+        {
+            return std::nullopt;
+        }
+        result.mapped_strings_ = std::string_view(strings, header.strings_size);
+
+        std::vector<symbols::SymbolId> symbol_ids(header.symbol_count);
+        for (size_t i = 0; i < symbol_ids.size(); ++i)
+        {
+            const uint32_t begin = symbol_offsets[i];
+            symbol_ids[i] = result.symbols_->Intern(std::string_view(names + begin, symbol_offsets[i + 1] - begin)).id;
+        }
+
+        for (size_t i = 0; i < result.kinds_.size(); ++i)
+        {
+            const uint8_t kind = result.kinds_[i];
+            uint32_t &payload = result.payloads_[i];
+            if (kind >= std::variant_size_v<TokenBase> ||
+                (kind == TokenKind<token_type::Id>() && payload >= symbol_ids.size()) ||
+                (kind == TokenKind<token_type::String>() && payload >= header.string_count) ||
+                (kind == TokenKind<token_type::BigNumber>() && payload >= header.big_number_count))
+            {
+                return std::nullopt;
+            }
+            if (kind == TokenKind<token_type::Id>())
+            {
+                payload = symbol_ids[payload];
+            }
+        }
+
+        return result;
+    }
+
+} // namespace parse
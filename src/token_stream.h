@@ -0,0 +1,166 @@
+#pragma once
+
+#include "lexer.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace parse
+{
+
+    // Номер типа лексемы T в варианте Token
+    template <typename T>
+    constexpr uint8_t TokenKind()
+    {
+        return []<typename... Ts>(const std::variant<Ts...> *)
+        {
+            uint8_t index = 0;
+            ((std::is_same_v<T, Ts> ? false : (++index, true)) && ...);
+            return index;
+        }(static_cast<const TokenBase *>(nullptr));
+    }
+
+    // Хеш исходного текста для проверки актуальности кэша токенов (FNV-1a, 64 бита)
+    uint64_t HashSource(std::string_view source);
+
+    // Компактная последовательность токенов в виде структуры массивов:
+    // по байту на тип лексемы и по 32-битному значению на полезную нагрузку.
+    // Number хранит число, Char - код символа, Id - номер в таблице символов потока (см. Symbols),
+    // String - номер строки в общем пуле, BigNumber - номер в отдельном массиве 64-битных чисел.
+    // Лексемы без значения нагрузку не используют
+    class TokenStream
+    {
+    public:
+        class Iterator;
+
+        // Имена Id интернируются в symbols; если она не задана, поток заводит свою таблицу
+        explicit TokenStream(std::shared_ptr<symbols::SymbolTable> symbols = nullptr);
+        // Забирает токены lexer от текущего до Eof включительно. Таблица символов общая с lexer
+        explicit TokenStream(Lexer &lexer);
+
+        void PushBack(const Token &token);
+
+        [[nodiscard]] size_t Size() const
+        {
+            return kinds_.size();
+        }
+
+        [[nodiscard]] bool Empty() const
+        {
+            return kinds_.empty();
+        }
+
+        // Номер типа i-й лексемы, см. TokenKind
+        [[nodiscard]] uint8_t Kind(size_t i) const
+        {
+            return kinds_[i];
+        }
+
+        template <typename T>
+        [[nodiscard]] bool Is(size_t i) const
+        {
+            return kinds_[i] == TokenKind<T>();
+        }
+
+        // Токен в обычном представлении. String ссылается на пул потока и живёт не дольше него
+        [[nodiscard]] Token operator[](size_t i) const;
+
+        [[nodiscard]] Iterator begin() const;
+        [[nodiscard]] Iterator end() const;
+
+        // Объём, занимаемый массивами и пулом строк
+        [[nodiscard]] size_t MemoryUsage() const;
+
+        // Таблица, номера которой хранятся в Id
+        [[nodiscard]] const std::shared_ptr<symbols::SymbolTable> &Symbols() const
+        {
+            return symbols_;
+        }
+
+        // Записывает поток в двоичный файл кэша (.mytok) вместе с хешем исходника source_hash.
+        // Файл пишется во временный и переименовывается, так что читатели не видят его недописанным.
+        // Формат зависит от порядка байт платформы. Возвращает false при ошибке записи
+        bool Save(const std::filesystem::path &path, uint64_t source_hash) const;
+
+        // Загружает кэш, записанный Save. Пул строк не копируется, а отображается из файла.
+        // Имена Id интернируются в symbols (или в новую таблицу, если она не задана).
+        // Возвращает std::nullopt, если файла нет, он повреждён или записан для другого исходника
+        static std::optional<TokenStream> Load(const std::filesystem::path &path, uint64_t source_hash,
+                                               std::shared_ptr<symbols::SymbolTable> symbols = nullptr);
+
+    private:
+        [[nodiscard]] std::string_view Strings() const
+        {
+            return mapping_.View().empty() ? std::string_view(strings_) : mapped_strings_;
+        }
+
+        std::shared_ptr<symbols::SymbolTable> symbols_;
+        std::vector<uint8_t> kinds_;
+        std::vector<uint32_t> payloads_;
+        // Строка i занимает [string_offsets_[i], string_offsets_[i + 1]) в пуле строк
+        std::vector<uint32_t> string_offsets_{0};
+        std::string strings_;
+        std::vector<int64_t> big_numbers_;
+        // Пул строк загруженного кэша лежит прямо в отображённом файле
+        MappedFile mapping_;
+        std::string_view mapped_strings_;
+    };
+
+    // Итератор, возвращающий токены по значению
+    class TokenStream::Iterator
+    {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Token;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = Token;
+
+        Iterator() = default;
+        Iterator(const TokenStream *stream, size_t index) : stream_(stream), index_(index) {}
+
+        Token operator*() const
+        {
+            return (*stream_)[index_];
+        }
+
+        Iterator &operator++()
+        {
+            ++index_;
+            return *this;
+        }
+
+        Iterator operator++(int)
+        {
+            auto copy = *this;
+            ++index_;
+            return copy;
+        }
+
+        bool operator==(const Iterator &other) const
+        {
+            return index_ == other.index_;
+        }
+
+    private:
+        const TokenStream *stream_ = nullptr;
+        size_t index_ = 0;
+    };
+
+    inline TokenStream::Iterator TokenStream::begin() const
+    {
+        return {this, 0};
+    }
+
+    inline TokenStream::Iterator TokenStream::end() const
+    {
+        return {this, Size()};
+    }
+
+} // namespace parse